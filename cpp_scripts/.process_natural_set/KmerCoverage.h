@@ -0,0 +1,225 @@
+#ifndef KMERCOVERAGE_H
+#define KMERCOVERAGE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../post_process_kmers/Parallel.h"
+
+// Coverage of the k-mer space: which of the 20^k k-mers of the standard amino
+// acids occur in a set. A k-mer is identified by its rank, the k-mer read as
+// a base-20 number with the residues in alphabetical order, so that ranks
+// order like the strings.
+//
+// Up to MAX_DENSE_COVERAGE_KMER_SIZE, presence is a dense bitset of 20^k bits
+// (160 MB for k = 7). Above, it is a roaring bitmap: ranks are split into
+// chunks of 2^16, and only chunks with ranks present are stored, each as the
+// sorted low 16 bits of its ranks while there are at most 4096 of them, and
+// as a bitset of 2^16 bits otherwise (both at most 8 KB).
+
+const char COVERAGE_ALPHABET[] = "ACDEFGHIKLMNPQRSTVWY";
+const int COVERAGE_ALPHABET_SIZE = 20;
+const int MAX_COVERAGE_KMER_SIZE = 14; // 20^14 < 2^64
+const int MAX_DENSE_COVERAGE_KMER_SIZE = 7;
+
+// index of residue in COVERAGE_ALPHABET, or -1
+inline int residueRank(char residue) {
+    static const std::vector<int8_t> ranks = [] {
+        std::vector<int8_t> table(256, -1);
+        for (int i = 0; i < COVERAGE_ALPHABET_SIZE; ++i)
+            table[static_cast<unsigned char>(COVERAGE_ALPHABET[i])] = static_cast<int8_t>(i);
+        return table;
+    }();
+    return ranks[static_cast<unsigned char>(residue)];
+}
+
+// number of k-mers of size k, 20^k
+inline uint64_t kmerSpaceSize(int k) {
+    uint64_t size = 1;
+    for (int i = 0; i < k; ++i)
+        size *= COVERAGE_ALPHABET_SIZE;
+    return size;
+}
+
+// Rank of kmer; false if it has a residue outside COVERAGE_ALPHABET.
+inline bool kmerRank(std::string_view kmer, uint64_t &rank) {
+    rank = 0;
+    for (char residue : kmer) {
+        int digit = residueRank(residue);
+        if (digit < 0)
+            return false;
+        rank = rank * COVERAGE_ALPHABET_SIZE + digit;
+    }
+    return true;
+}
+
+// Writes the k-mer of rank, k characters, to kmer.
+inline void kmerOfRank(uint64_t rank, int k, char *kmer) {
+    for (int i = k - 1; i >= 0; --i, rank /= COVERAGE_ALPHABET_SIZE)
+        kmer[i] = COVERAGE_ALPHABET[rank % COVERAGE_ALPHABET_SIZE];
+}
+
+class KmerCoverage {
+public:
+    static constexpr int CHUNK_BITS = 16;
+    static constexpr uint64_t CHUNK_SIZE = uint64_t(1) << CHUNK_BITS;
+    static constexpr size_t CHUNK_WORDS = CHUNK_SIZE / 64;
+    static constexpr size_t MAX_ARRAY_SIZE = 4096; // above, a bitset is smaller
+
+    // ranks: the distinct ranks present; sorted in place
+    KmerCoverage(int k, std::vector<uint64_t> &ranks) : k(k), space(kmerSpaceSize(k)), present(ranks.size()) {
+        std::sort(ranks.begin(), ranks.end());
+        if (k <= MAX_DENSE_COVERAGE_KMER_SIZE) {
+            bits.assign((space + 63) / 64, 0);
+            for (uint64_t rank : ranks)
+                bits[rank / 64] |= uint64_t(1) << (rank % 64);
+            return;
+        }
+
+        for (size_t begin = 0, end; begin < ranks.size(); begin = end) {
+            uint64_t key = ranks[begin] >> CHUNK_BITS;
+            end = begin;
+            while (end < ranks.size() && ranks[end] >> CHUNK_BITS == key)
+                ++end;
+
+            Chunk &chunk = chunks.emplace_back();
+            chunk.key = key;
+            if (end - begin <= MAX_ARRAY_SIZE) {
+                for (size_t i = begin; i < end; ++i)
+                    chunk.array.push_back(static_cast<uint16_t>(ranks[i]));
+            } else {
+                chunk.bits.assign(CHUNK_WORDS, 0);
+                for (size_t i = begin; i < end; ++i) {
+                    uint64_t low = ranks[i] & (CHUNK_SIZE - 1);
+                    chunk.bits[low / 64] |= uint64_t(1) << (low % 64);
+                }
+            }
+        }
+    }
+
+    int kmerSize() const { return k; }
+    uint64_t spaceSize() const { return space; }
+    uint64_t presentCount() const { return present; }
+    uint64_t chunkCount() const { return (space + CHUNK_SIZE - 1) >> CHUNK_BITS; }
+    bool isDense() const { return !bits.empty(); }
+
+    size_t memoryBytes() const {
+        size_t bytes = bits.size() * sizeof(uint64_t) + chunks.size() * sizeof(Chunk);
+        for (const auto &chunk : chunks)
+            bytes += chunk.array.size() * sizeof(uint16_t) + chunk.bits.size() * sizeof(uint64_t);
+        return bytes;
+    }
+
+    bool contains(uint64_t rank) const {
+        if (isDense())
+            return rank < space && (bits[rank / 64] >> (rank % 64) & 1);
+
+        const Chunk *chunk = findChunk(rank >> CHUNK_BITS);
+        if (!chunk)
+            return false;
+        auto low = static_cast<uint16_t>(rank);
+        if (!chunk->bits.empty())
+            return chunk->bits[low / 64] >> (low % 64) & 1;
+        return std::binary_search(chunk->array.begin(), chunk->array.end(), low);
+    }
+
+    // Fills words (CHUNK_WORDS of them) with the presence bits of the ranks
+    // of chunk index; bits past the end of the space are set, as if present.
+    void chunkWords(uint64_t index, uint64_t *words) const {
+        if (isDense()) {
+            size_t first = index * CHUNK_WORDS;
+            size_t count = std::min(CHUNK_WORDS, bits.size() - first);
+            std::memcpy(words, bits.data() + first, count * sizeof(uint64_t));
+            std::fill(words + count, words + CHUNK_WORDS, 0);
+        } else if (const Chunk *chunk = findChunk(index)) {
+            if (!chunk->bits.empty()) {
+                std::memcpy(words, chunk->bits.data(), CHUNK_WORDS * sizeof(uint64_t));
+            } else {
+                std::fill(words, words + CHUNK_WORDS, 0);
+                for (uint16_t low : chunk->array)
+                    words[low / 64] |= uint64_t(1) << (low % 64);
+            }
+        } else {
+            std::fill(words, words + CHUNK_WORDS, 0);
+        }
+
+        // ranks past the end of the space
+        uint64_t chunkStart = index << CHUNK_BITS;
+        if (chunkStart + CHUNK_SIZE > space) {
+            uint64_t valid = space - chunkStart;
+            for (size_t w = valid / 64; w < CHUNK_WORDS; ++w) {
+                uint64_t firstBit = w * 64 < valid ? valid % 64 : 0;
+                words[w] |= ~uint64_t(0) << firstBit;
+            }
+        }
+    }
+
+private:
+    struct Chunk {
+        uint64_t key; // rank >> CHUNK_BITS
+        std::vector<uint16_t> array; // sorted low bits of the ranks, or
+        std::vector<uint64_t> bits; // CHUNK_WORDS words of presence bits
+    };
+
+    const Chunk *findChunk(uint64_t key) const {
+        auto it = std::lower_bound(chunks.begin(), chunks.end(), key,
+                                   [](const Chunk &chunk, uint64_t key) { return chunk.key < key; });
+        return it != chunks.end() && it->key == key ? &*it : nullptr;
+    }
+
+    int k;
+    uint64_t space;
+    uint64_t present;
+    std::vector<uint64_t> bits; // dense
+    std::vector<Chunk> chunks; // roaring, by key
+};
+
+// Writes the k-mers absent from coverage to write(text), one per line, in
+// rank (alphabetical) order, without holding more than a few chunks of them
+// at a time. The chunks are scanned a word at a time on threadCount threads,
+// in rounds of CHUNKS_PER_THREAD chunks per thread, and each round is written
+// in order once it is complete. Returns the number of absent k-mers.
+template <typename Write>
+uint64_t writeAbsentKmers(const KmerCoverage &coverage, unsigned int threadCount, Write write) {
+    const size_t CHUNKS_PER_THREAD = 16;
+    const int k = coverage.kmerSize();
+    const uint64_t chunkCount = coverage.chunkCount();
+    const size_t roundSize = std::max(1u, threadCount) * CHUNKS_PER_THREAD;
+
+    std::vector<std::string> texts(roundSize);
+    std::vector<std::vector<uint64_t>> words(std::max(1u, threadCount),
+                                             std::vector<uint64_t>(KmerCoverage::CHUNK_WORDS));
+    uint64_t absentCount = 0;
+
+    for (uint64_t first = 0; first < chunkCount; first += roundSize) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(roundSize, chunkCount - first));
+        parallelFor(count, threadCount, [&](size_t i, unsigned int thread) {
+            std::string &text = texts[i];
+            text.clear();
+            uint64_t *chunkWords = words[thread].data();
+            coverage.chunkWords(first + i, chunkWords);
+
+            uint64_t chunkStart = (first + i) << KmerCoverage::CHUNK_BITS;
+            char kmer[MAX_COVERAGE_KMER_SIZE + 1];
+            kmer[k] = '\n';
+            for (size_t w = 0; w < KmerCoverage::CHUNK_WORDS; ++w) {
+                for (uint64_t absent = ~chunkWords[w]; absent; absent &= absent - 1) {
+                    kmerOfRank(chunkStart + w * 64 + __builtin_ctzll(absent), k, kmer);
+                    text.append(kmer, k + 1);
+                }
+            }
+        });
+
+        for (size_t i = 0; i < count; ++i) {
+            absentCount += texts[i].size() / (k + 1);
+            write(texts[i]);
+        }
+    }
+    return absentCount;
+}
+
+#endif // KMERCOVERAGE_H
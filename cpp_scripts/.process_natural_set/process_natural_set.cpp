@@ -2,33 +2,69 @@
 #include <unordered_map>
 #include <vector>
 #include <algorithm>
+#include <iomanip>
+
+#include "KmerCoverage.h"
 
 // using namespace std;
 
 void printHelp() {
-    std::cout << "Usage: ./program [-k <kmer size>] [-f] [-s] [--help]\n"
+    std::cout << "Usage: ./program [-k <kmer size>] [-f] [-s] [-j <threads>] [--help]\n"
          << "Options:\n"
          << "  -k <kmer size>     Set the size of the kmers (default=12)\n"
          << "  -f                 Output frequencies only (default=false)\n"
-         << "  -s                 Output statistics and missing kmers (default=false)\n"
+         << "  -s                 Output statistics and missing kmers (default=false);\n"
+         << "                     kmer size at most " << MAX_COVERAGE_KMER_SIZE << "\n"
+         << "  -j <threads>       Threads to find missing kmers with (0 = all cores, default=1)\n"
          << "  --help, -h         Show this help message\n";
 }
 
-// Generate synthetic set using recursion
-// void generateSyntheticSet(const string& kmer, int k, const unordered_map<string, int>& naturalSet, const function<void(const string&)>& callback) {
-//     static string aminoAcids = "ACDEFGHIKLMNPQRSTVWY";
-
-//     if (k == 0) {
-//         if (naturalSet.find(kmer) == naturalSet.end()) {
-//             callback(kmer);
-//         }
-//         return;
-//     }
+// Prints the coverage of the k-mer space by the natural set, its frequency
+// histogram and singleton fraction, then every k-mer missing from it (the
+// synthetic set), streamed from the coverage bitmap.
+void printStatsAndMissingKmers(const std::unordered_map<std::string, int> &kmerCounts, int kmerSize,
+                               unsigned int threadCount) {
+	// frequency histogram: bucket b counts the k-mers occurring [2^b, 2^(b+1)) times
+	std::vector<uint64_t> histogram;
+	std::vector<uint64_t> ranks;
+	uint64_t singletons = 0, unranked = 0;
+	ranks.reserve(kmerCounts.size());
+	for (const auto &[kmer, count] : kmerCounts) {
+		uint64_t rank;
+		if (!kmerRank(kmer, rank)) { // non-standard residues, outside the k-mer space
+			unranked++;
+			continue;
+		}
+		ranks.push_back(rank);
+
+		size_t bucket = 0;
+		while (count >> (bucket + 1))
+			bucket++;
+		if (histogram.size() <= bucket)
+			histogram.resize(bucket + 1);
+		histogram[bucket]++;
+		if (count == 1)
+			singletons++;
+	}
 
-//     for (char c : aminoAcids) {
-//         generateSyntheticSet(kmer + c, k - 1, naturalSet, callback);
-//     }
-// }
+	KmerCoverage coverage(kmerSize, ranks);
+	uint64_t present = coverage.presentCount();
+	std::cout << std::fixed << std::setprecision(6)
+	          << "Coverage: " << static_cast<double>(present) / coverage.spaceSize() * 100 << "% ("
+	          << present << "/" << coverage.spaceSize() << ")\n"
+	          << "Singletons: " << static_cast<double>(singletons) / std::max<uint64_t>(present, 1) * 100 << "% ("
+	          << singletons << "/" << present << ")\n"
+	          << "Non-standard kmers: " << unranked << "\n"
+	          << "Bitmap: " << (coverage.isDense() ? "dense, " : "roaring, ") << coverage.memoryBytes() << " bytes\n"
+	          << "Frequency histogram:\n";
+	for (size_t b = 0; b < histogram.size(); ++b)
+		std::cout << "  " << (uint64_t(1) << b) << "-" << (uint64_t(2) << b) - 1 << ": " << histogram[b] << "\n";
+
+	std::cout << "Missing: " << coverage.spaceSize() - present << "\n";
+	writeAbsentKmers(coverage, threadCount, [](const std::string &kmers) {
+		std::cout.write(kmers.data(), kmers.size());
+	});
+}
 
 // Main function
 int main(int argc, char* argv[]) {
@@ -39,6 +75,7 @@ int main(int argc, char* argv[]) {
 	int kmerSize = 12;
 	bool outputFrequenciesOnly = false;
 	bool outputStatsAndMissingKmers = false;
+	unsigned int threadCount = 1;
 
 
 	// Check command-line arguments
@@ -59,12 +96,20 @@ int main(int argc, char* argv[]) {
 		else if (arg == "-s") {
 			outputStatsAndMissingKmers = true;
 		}
+		else if (arg == "-j" && i + 1 < argc) {
+			threadCount = resolveThreadCount(std::stoi(argv[++i]));
+		}
 		else if (arg == "--help" || arg == "-h") {
 		    printHelp();
 		    return 0;
 		}
 	}
 
+	if (outputStatsAndMissingKmers && (kmerSize < 1 || kmerSize > MAX_COVERAGE_KMER_SIZE)) {
+		std::cerr << "-s requires a kmer size from 1 to " << MAX_COVERAGE_KMER_SIZE << "." << std::endl;
+		return 1;
+	}
+
 	std::unordered_map<std::string, int> kmerCounts;
 
 	std::string inputLine;
@@ -97,12 +142,8 @@ int main(int argc, char* argv[]) {
 	}
 
 	// Output statistics and missing kmers
-	// if (outputStatsAndMissingKmers) {
-	// 	cout << "Coverage: " << static_cast<double>(kmerCounts.size()) / pow(20, kmerSize) * 100 << "% (" << kmerCounts.size() << "/" << static_cast<int>(pow(20, kmerSize)) << ")\n";
-	// 	generateSyntheticSet("", kmerSize, kmerCounts, [](const string& missingKmer) {
-	// 		cout << missingKmer << "\n";
-	// 	});
-	// }
+	if (outputStatsAndMissingKmers)
+		printStatsAndMissingKmers(kmerCounts, kmerSize, threadCount);
 
 	return 0;
 }
@@ -0,0 +1,110 @@
+#ifndef BENCHMARKREPORT_H
+#define BENCHMARKREPORT_H
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Results of one benchmark, printed as aligned text, or as JSON with
+// --json:
+//     {"benchmarks": [{"benchmark": "parse", "results": [
+//         {"name": "record parser", "value": 2314.9, "unit": "MB/s", "note": "7.3x"}, ...]}, ...]}
+// Results without a value (e.g. a kernel the CPU does not support) have
+// "value": null.
+class BenchmarkReport {
+public:
+    explicit BenchmarkReport(std::string benchmark) : benchmark(std::move(benchmark)) {}
+
+    void add(const std::string &name, double value, const std::string &unit, const std::string &note = "") {
+        results.push_back({name, value, unit, note});
+    }
+
+    void addNote(const std::string &name, const std::string &note) {
+        results.push_back({name, NAN, "", note});
+    }
+
+    const std::string &name() const { return benchmark; }
+
+    void printText(std::ostream &out) const {
+        size_t width = 0;
+        for (const auto &result : results)
+            width = std::max(width, result.name.size() + 2);
+
+        for (const auto &result : results) {
+            out << std::left << std::setw(static_cast<int>(width)) << result.name + ":";
+            if (!std::isnan(result.value)) {
+                if (result.value == std::floor(result.value) && std::abs(result.value) < 1e15)
+                    out << static_cast<long long>(result.value);
+                else
+                    out << std::fixed << std::setprecision(1) << result.value;
+                out << ' ' << result.unit;
+                if (!result.note.empty())
+                    out << " (" << result.note << ')';
+            } else {
+                out << result.note;
+            }
+            out << '\n';
+        }
+    }
+
+    void printJson(std::ostream &out) const {
+        out << "{\"benchmark\": " << quote(benchmark) << ", \"results\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const auto &result = results[i];
+            out << (i ? ", " : "") << "{\"name\": " << quote(result.name) << ", \"value\": ";
+            if (std::isnan(result.value))
+                out << "null";
+            else
+                out << std::defaultfloat << std::setprecision(10) << result.value;
+            out << ", \"unit\": " << quote(result.unit) << ", \"note\": " << quote(result.note) << '}';
+        }
+        out << "]}";
+    }
+
+    // Prints reports as text, or as one JSON document.
+    static void print(const std::vector<BenchmarkReport> &reports, bool json, std::ostream &out) {
+        if (!json) {
+            for (size_t i = 0; i < reports.size(); ++i) {
+                if (reports.size() > 1)
+                    out << (i ? "\n" : "") << "[" << reports[i].name() << "]\n";
+                reports[i].printText(out);
+            }
+            out << std::flush;
+            return;
+        }
+
+        out << "{\"benchmarks\": [";
+        for (size_t i = 0; i < reports.size(); ++i) {
+            out << (i ? ", " : "");
+            reports[i].printJson(out);
+        }
+        out << "]}" << std::endl;
+    }
+
+private:
+    struct Result {
+        std::string name;
+        double value;
+        std::string unit;
+        std::string note;
+    };
+
+    static std::string quote(const std::string &text) {
+        std::string quoted = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                quoted += '\\';
+            quoted += c;
+        }
+        return quoted + '"';
+    }
+
+    std::string benchmark;
+    std::vector<Result> results;
+};
+
+#endif // BENCHMARKREPORT_H
@@ -0,0 +1,232 @@
+#include "SyntheticCorpus.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+const char *const RESIDUE_NAMES[] = {
+    "ALA", "ARG", "ASN", "ASP", "CYS", "GLN", "GLU", "GLY", "HIS", "ILE",
+    "LEU", "LYS", "MET", "PHE", "PRO", "SER", "THR", "TYR", "TRP", "VAL"
+};
+const char RESIDUE_CODES[] = "ARNDCQEGHILKMFPSTYWV";
+const int RESIDUE_COUNT = 20;
+
+const double CA_DISTANCE = 3.8; // angstroms between consecutive CA atoms
+const size_t FASTA_LINE_LENGTH = 60;
+
+// mt19937_64 output is the same everywhere, unlike the standard distributions
+class Random {
+public:
+    explicit Random(uint64_t seed) : engine(seed) {}
+
+    size_t below(size_t n) { return engine() % n; }
+    double unit() { return (engine() >> 11) * 0x1.0p-53; }
+    double between(double low, double high) { return low + (high - low) * unit(); }
+
+private:
+    std::mt19937_64 engine;
+};
+
+// Appends a PDB line, padded to 80 columns.
+void appendLine(std::string &text, const char *format, ...) {
+    char line[128];
+    va_list args;
+    va_start(args, format);
+    int length = std::vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    text.append(line, std::min<size_t>(length, sizeof(line) - 1));
+    if (length < 80)
+        text.append(80 - length, ' ');
+    text += '\n';
+}
+
+// 4 character PDB id of entry i, digit first
+std::string pdbIdOf(size_t i) {
+    const char *alphabet = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    std::string id(4, '0');
+    id[0] = alphabet[1 + i / (36 * 36 * 36) % 9];
+    for (int position = 3; position > 0; --position, i /= 36)
+        id[position] = alphabet[i % 36];
+    return id;
+}
+
+std::string accessionOf(size_t i, int chain) {
+    char accession[16];
+    std::snprintf(accession, sizeof(accession), "S%07zu", i * 26 + chain);
+    return accession;
+}
+
+void appendFastaRecord(std::ofstream &fasta, const std::string &accession, const std::string &sequence) {
+    fasta << ">sp|" << accession << '|' << accession << "_SYNTH Synthetic protein OS=Homo sapiens\n";
+    for (size_t i = 0; i < sequence.size(); i += FASTA_LINE_LENGTH)
+        fasta << sequence.substr(i, FASTA_LINE_LENGTH) << '\n';
+}
+
+enum class Reference { DBREF, DBREF1, NONE };
+
+// Text of one entry; the sequence of each chain is stored in sequences.
+std::string generateEntry(const std::string &pdbId, size_t index, Reference reference, bool lowResolution,
+                          const SyntheticOptions &options, Random &random, std::vector<std::string> &sequences) {
+    std::string text;
+    appendLine(text, "HEADER    %-40s01-JAN-00   %s", "HYDROLASE", pdbId.c_str());
+    appendLine(text, "TITLE     SYNTHETIC ENTRY %s", pdbId.c_str());
+    appendLine(text, "REMARK   1");
+    appendLine(text, "REMARK   2");
+    appendLine(text, "REMARK   2 RESOLUTION.    %4.2f ANGSTROMS.",
+               lowResolution ? random.between(3.0, 4.0) : random.between(1.0, 2.4));
+    for (int i = 0; i < options.remarks; ++i)
+        appendLine(text, "REMARK   3   SYNTHETIC REFINEMENT DETAIL %6d : %8.4f", i, random.unit());
+
+    std::vector<std::vector<int>> residues(options.chains, std::vector<int>(options.residues));
+    sequences.assign(options.chains, std::string());
+    for (int chain = 0; chain < options.chains; ++chain) {
+        for (auto &residue : residues[chain]) {
+            residue = static_cast<int>(random.below(RESIDUE_COUNT));
+            sequences[chain] += RESIDUE_CODES[residue];
+        }
+    }
+
+    for (int chain = 0; chain < options.chains; ++chain) {
+        char chainId = static_cast<char>('A' + chain);
+        std::string accession = accessionOf(index, chain);
+        if (reference == Reference::DBREF) {
+            appendLine(text, "DBREF  %s %c    1  %4d  UNP    %-8s %-12s    1  %4d", pdbId.c_str(), chainId,
+                       options.residues, accession.c_str(), (accession + "_SYNTH").c_str(), options.residues);
+        } else if (reference == Reference::DBREF1) {
+            appendLine(text, "DBREF1 %s %c    1  %4d  UNP                  %-20s", pdbId.c_str(), chainId,
+                       options.residues, (accession + "_SYNTH").c_str());
+            appendLine(text, "DBREF2 %s %c     %-22s     1  %4d", pdbId.c_str(), chainId, accession.c_str(),
+                       options.residues);
+        }
+    }
+
+    for (int chain = 0; chain < options.chains; ++chain) {
+        for (int i = 0; i < options.residues; i += 13) {
+            std::string names;
+            for (int j = i; j < std::min(i + 13, options.residues); ++j)
+                names += std::string(RESIDUE_NAMES[residues[chain][j]]) + ' ';
+            appendLine(text, "SEQRES %3d %c %4d  %s", i / 13 + 1, 'A' + chain, options.residues, names.c_str());
+        }
+    }
+
+    int serial = 1;
+    for (int model = 1; model <= options.models; ++model) {
+        if (options.models > 1)
+            appendLine(text, "MODEL     %4d", model);
+
+        for (int chain = 0; chain < options.chains; ++chain) {
+            char chainId = static_cast<char>('A' + chain);
+            double x = random.between(-20, 20), y = random.between(-20, 20), z = random.between(-20, 20);
+            for (int i = 0; i < options.residues; ++i) {
+                // CA trace as a random walk
+                double dx = random.between(-1, 1), dy = random.between(-1, 1), dz = random.between(-1, 1);
+                double scale = CA_DISTANCE / std::max(1e-6, std::sqrt(dx * dx + dy * dy + dz * dz));
+                x += dx * scale;
+                y += dy * scale;
+                z += dz * scale;
+
+                const char *name = RESIDUE_NAMES[residues[chain][i]];
+                const char *atoms[] = {" N  ", " CA ", " C  ", " O  "};
+                const double offsets[] = {-1.2, 0.0, 1.3, 2.1};
+                for (int atom = 0; atom < 4; ++atom) {
+                    appendLine(text, "ATOM  %5d %s %s %c%4d    %8.3f%8.3f%8.3f  1.00 20.00           %c",
+                               serial++ % 100000, atoms[atom], name, chainId, i + 1, x + offsets[atom], y, z,
+                               atoms[atom][1]);
+                }
+            }
+            appendLine(text, "TER   %5d      %s %c%4d", serial++ % 100000,
+                       RESIDUE_NAMES[residues[chain].back()], chainId, options.residues);
+        }
+
+        if (options.models > 1)
+            appendLine(text, "ENDMDL");
+    }
+    appendLine(text, "END");
+    return text;
+}
+
+} // namespace
+
+bool generateSyntheticCorpus(const std::string &directory, const SyntheticOptions &options,
+                             SyntheticCorpus &corpus, std::string &error) {
+    namespace fs = std::filesystem;
+    corpus = SyntheticCorpus();
+    corpus.pdbDirectory = (fs::path(directory) / "pdb").string();
+    corpus.fastaPath = (fs::path(directory) / "uniprot.fasta").string();
+
+    // files of an earlier corpus in the directory would be read along with
+    // the new ones
+    std::error_code ec;
+    fs::remove_all(corpus.pdbDirectory, ec);
+    if (!ec)
+        fs::create_directories(corpus.pdbDirectory, ec);
+    std::ofstream fasta(corpus.fastaPath);
+    if (ec || !fasta) {
+        error = "Could not write to " + directory;
+        return false;
+    }
+
+    Random random(options.seed);
+    std::vector<std::string> sequences;
+    for (size_t i = 0; i < options.files; ++i) {
+        double draw = random.unit();
+        Reference reference = draw < options.dbrefFraction ? Reference::DBREF
+            : draw < options.dbrefFraction + options.dbref1Fraction ? Reference::DBREF1
+            : Reference::NONE;
+        bool lowResolution = random.unit() < options.lowResolutionFraction;
+
+        std::string pdbId = pdbIdOf(i);
+        std::string text = generateEntry(pdbId, i, reference, lowResolution, options, random, sequences);
+
+        // pdb/<middle two characters>/pdb<id>.ent.gz, as in the PDB mirror
+        std::string lowerId = pdbId;
+        for (auto &c : lowerId)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        fs::path subdirectory = fs::path(corpus.pdbDirectory) / lowerId.substr(1, 2);
+        fs::create_directories(subdirectory, ec);
+        std::string path = (subdirectory / ("pdb" + lowerId + ".ent.gz")).string();
+
+        gzFile file = gzopen(path.c_str(), "wb6");
+        bool written = file && gzwrite(file, text.data(), static_cast<unsigned int>(text.size())) > 0;
+        if (file)
+            written = gzclose(file) == Z_OK && written;
+        if (!written) {
+            error = "Could not write " + path;
+            return false;
+        }
+        corpus.files++;
+        corpus.pdbBytes += text.size();
+
+        if (reference != Reference::NONE) {
+            for (int chain = 0; chain < options.chains; ++chain) {
+                appendFastaRecord(fasta, accessionOf(i, chain), sequences[chain]);
+                corpus.sequences++;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < options.extraSequences; ++i) {
+        std::string sequence;
+        for (int j = 0; j < options.residues; ++j)
+            sequence += RESIDUE_CODES[random.below(RESIDUE_COUNT)];
+        appendFastaRecord(fasta, accessionOf(options.files + i, 0), sequence);
+        corpus.sequences++;
+    }
+
+    fasta.close();
+    if (!fasta) {
+        error = "Could not write " + corpus.fastaPath;
+        return false;
+    }
+    return true;
+}
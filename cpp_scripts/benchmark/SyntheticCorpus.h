@@ -0,0 +1,39 @@
+#ifndef SYNTHETICCORPUS_H
+#define SYNTHETICCORPUS_H
+
+#include <cstdint>
+#include <string>
+
+// Shape of a synthetic corpus; every PDB entry has the same number of chains,
+// residues per chain and models.
+struct SyntheticOptions {
+    size_t files = 200;
+    int chains = 2;
+    int residues = 300; // per chain, at most 9999
+    int models = 1;
+    int remarks = 100; // REMARK 3 lines per entry, before the sequences
+    double dbrefFraction = 0.8; // entries whose chains have DBREF records
+    double dbref1Fraction = 0.1; // entries with DBREF1/DBREF2 records; the rest have none
+    double lowResolutionFraction = 0.1; // entries rejected as RESOLUTION_TOO_LOW
+    size_t extraSequences = 1000; // FASTA records no entry refers to
+    uint64_t seed = 1;
+};
+
+struct SyntheticCorpus {
+    std::string pdbDirectory; // <directory>/pdb, laid out like the PDB mirror
+    std::string fastaPath; // <directory>/uniprot.fasta
+    size_t files = 0;
+    size_t pdbBytes = 0; // decompressed
+    size_t sequences = 0;
+};
+
+// Writes a synthetic corpus to directory: gzipped PDB entries with random
+// sequences and CA traces, and UniProt-style FASTA holding the sequence of
+// every chain with a DBREF or DBREF1/DBREF2 record, so that the entries match
+// their UniProt sequences, and extra unreferenced records. The output only
+// depends on options. Any existing directory/pdb is removed first. Returns
+// false, with the reason in error, if it cannot be written.
+bool generateSyntheticCorpus(const std::string &directory, const SyntheticOptions &options,
+                             SyntheticCorpus &corpus, std::string &error);
+
+#endif // SYNTHETICCORPUS_H
@@ -0,0 +1,660 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../extract_pdb_coordinates/AtomDataParser.h"
+#include "../extract_pdb_coordinates/BatchProcessor.h"
+#include "../extract_pdb_coordinates/Constants.h"
+#include "../extract_pdb_coordinates/DistanceKernels.h"
+#include "../extract_pdb_coordinates/GZStreamBuf.h"
+#include "../extract_pdb_coordinates/NeighbourGrid.h"
+#include "../extract_pdb_coordinates/PDBContext.h"
+#include "../extract_pdb_coordinates/PDBParser.h"
+#include "../extract_pdb_coordinates/PDBRecord.h"
+#include "../extract_pdb_coordinates/Utils.h"
+#include "../fasta_to_sqlite/FastaInput.h"
+#include "../fasta_to_sqlite/FastaParser.h"
+#include "../fasta_to_sqlite/SequenceDatabase.h"
+#include "../fasta_to_sqlite/SequenceStoreWriter.h"
+#include "../post_process_kmers/KmerCounts.h"
+#include "BenchmarkReport.h"
+#include "SyntheticCorpus.h"
+
+// FASTA records per batch, as in fasta_to_sqlite
+const size_t FASTA_BATCH_SIZE = 10000;
+
+// Record parsing as done before the string_view parser, and residue lookup
+// before the packed table, kept as a baseline.
+namespace legacy {
+    const std::unordered_map<std::string, char> aminoAcidLookup = {
+        {"ALA", 'A'}, {"ARG", 'R'}, {"ASN", 'N'}, {"ASP", 'D'},
+        {"CYS", 'C'}, {"GLN", 'Q'}, {"GLU", 'E'}, {"GLY", 'G'},
+        {"HIS", 'H'}, {"HIP", 'H'}, {"HIE", 'H'}, {"ILE", 'I'},
+        {"LEU", 'L'}, {"LYS", 'K'}, {"MET", 'M'}, {"PHE", 'F'},
+        {"PRO", 'P'}, {"SER", 'S'}, {"THR", 'T'}, {"TYR", 'Y'},
+        {"TRP", 'W'}, {"VAL", 'V'}, {"SEC", 'U'}, {"PYL", 'O'},
+        {"XPL", 'O'}, {"GLX", 'Z'}, {"ASX", 'B'}, {"UNK", '.'}
+    };
+
+    const std::unordered_set<char> invalidAminoAcids{'U', 'O', 'Z', 'B', '.'};
+
+    struct AtomData
+    {
+        bool isValidAtom;
+        std::string resName;
+        int resSeq;
+        float x, y, z;
+
+        AtomData(const std::string& str)
+        {
+            std::string atom_name = str.substr(12, 4);
+
+            isValidAtom = atom_name == " CA ";
+            if (!isValidAtom)
+                return;
+
+            resName = str.substr(17, 3);
+            resSeq = std::stoi(str.substr(22, 4));
+            x = std::stof(str.substr(30, 8));
+            y = std::stof(str.substr(38, 8));
+            z = std::stof(str.substr(46, 8));
+        }
+    };
+
+    void processSequence(const std::string &line, PDBContext &con) {
+        char chainId = line[11];
+        std::string aa;
+        std::string aaLine = line.substr(19, 51);
+        std::stringstream aaStream(aaLine);
+        while (aaStream >> aa) {
+            try {
+                con.chainSequences[chainId] += aminoAcidLookup.at(aa);
+            } catch (const std::out_of_range &) {
+                con.chainSequences[chainId] += '.';
+                return;
+            }
+        }
+    }
+}
+
+struct Corpus {
+    std::vector<std::string> files; // decompressed contents
+    std::vector<std::vector<std::string>> lines;
+    size_t bytes = 0;
+};
+
+Corpus loadCorpus(const std::vector<std::string> &paths) {
+    Corpus corpus;
+    GZStreamBuf gzBuffer;
+
+    for (const auto &path : collectInputFiles(paths)) {
+        if (!gzBuffer.open(path)) {
+            std::cerr << "Failed to open file " << path << std::endl;
+            continue;
+        }
+
+        std::istream in(&gzBuffer);
+        std::ostringstream contents;
+        contents << in.rdbuf();
+        gzBuffer.close();
+
+        corpus.files.push_back(contents.str());
+        corpus.bytes += corpus.files.back().size();
+
+        std::istringstream lineStream(corpus.files.back());
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(lineStream, line);)
+            lines.push_back(line);
+        corpus.lines.push_back(std::move(lines));
+    }
+
+    return corpus;
+}
+
+// "<ratio>x", for the speedup over a baseline
+std::string speedup(double ratio) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1) << ratio << 'x';
+    return out.str();
+}
+
+// Runs fn once per repeat and returns the seconds per repeat.
+template <typename Function>
+double measureSeconds(int repeats, Function fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i)
+        fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeats;
+}
+
+// Runs fn once per repeat and returns the throughput in MB/s.
+template <typename Function>
+double measureThroughput(size_t bytes, int repeats, Function fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i)
+        fn();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return bytes * static_cast<double>(repeats) / 1e6 / seconds;
+}
+
+// Makes the compiler treat value as used, so that the work computing it is
+// not optimised away.
+template <typename T>
+void keepAlive(const T &value) {
+    asm volatile("" : : "g"(value) : "memory");
+}
+
+int benchmarkParse(const std::vector<std::string> &paths, int repeats, BenchmarkReport &report) {
+    Corpus corpus = loadCorpus(paths);
+    if (corpus.files.empty()) {
+        std::cerr << "No PDB files found." << std::endl;
+        return 1;
+    }
+
+    PDBContext con;
+    double checksum = 0; // keeps the parsed values alive
+
+    double legacyRate = measureThroughput(corpus.bytes, repeats, [&]() {
+        for (const auto &lines : corpus.lines) {
+            con.reset();
+            for (const auto &line : lines) {
+                std::string param = line.substr(0, 6);
+                if (param == "ATOM  ") {
+                    legacy::AtomData data(line);
+                    if (data.isValidAtom)
+                        checksum += data.x + data.resSeq;
+                } else if (param == "SEQRES") {
+                    legacy::processSequence(line, con);
+                }
+            }
+        }
+    });
+
+    double recordRate = measureThroughput(corpus.bytes, repeats, [&]() {
+        for (const auto &lines : corpus.lines) {
+            con.reset();
+            for (const auto &line : lines) {
+                uint64_t tag = recordTag(line);
+                if (tag == TAG_ATOM) {
+                    AtomData data(line);
+                    if (data.isValidAtom)
+                        checksum += data.x + data.resSeq;
+                } else if (tag == TAG_SEQRES) {
+                    processSequence(line, con);
+                }
+            }
+        }
+    });
+
+    std::ostringstream out;
+    double streamRate = measureThroughput(corpus.bytes, repeats, [&]() {
+        for (const auto &file : corpus.files) {
+            std::istringstream in(file);
+            out.str("");
+            processPDBStream(in, out, con);
+        }
+    });
+
+    report.add("files", corpus.files.size(), "files");
+    report.add("corpus", corpus.bytes / 1e6, "MB");
+    report.add("legacy record parser", legacyRate, "MB/s");
+    report.add("record parser", recordRate, "MB/s", speedup(recordRate / legacyRate));
+    report.add("processPDBStream", streamRate, "MB/s");
+
+    keepAlive(checksum);
+    return 0;
+}
+
+// Per-residue cost of residue name lookup, over the residue names of the
+// SEQRES and CA ATOM records, and of parsing the SEQRES records.
+int benchmarkResidues(const std::vector<std::string> &paths, int repeats, BenchmarkReport &report) {
+    Corpus corpus = loadCorpus(paths);
+
+    std::vector<std::string> names;
+    std::vector<const std::string *> seqresLines;
+    size_t seqresResidues = 0;
+    for (const auto &lines : corpus.lines) {
+        for (const auto &line : lines) {
+            uint64_t tag = recordTag(line);
+            if (tag == TAG_SEQRES) {
+                seqresLines.push_back(&line);
+                std::istringstream tokens(line.size() > 19 ? line.substr(19, 51) : "");
+                for (std::string name; tokens >> name; ++seqresResidues)
+                    names.push_back(name);
+            } else if (tag == TAG_ATOM) {
+                AtomData data(line);
+                if (data.isValidAtom)
+                    names.emplace_back(data.resName);
+            }
+        }
+    }
+
+    if (names.empty()) {
+        std::cerr << "No residues found." << std::endl;
+        return 1;
+    }
+
+    // nanoseconds per residue of repeats passes of fn over count residues
+    auto nanosecondsPerResidue = [&](size_t count, auto fn) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; ++i)
+            fn();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return seconds * 1e9 / (count * static_cast<double>(repeats));
+    };
+
+    size_t checksum = 0; // keeps the looked up codes alive
+    double mapLookup = nanosecondsPerResidue(names.size(), [&]() {
+        for (const auto &name : names) {
+            auto lookup = legacy::aminoAcidLookup.find(name);
+            char aminoAcid = lookup == legacy::aminoAcidLookup.end() ? '.' : lookup->second;
+            checksum += aminoAcid + legacy::invalidAminoAcids.count(aminoAcid);
+        }
+    });
+    double tableLookup = nanosecondsPerResidue(names.size(), [&]() {
+        for (const auto &name : names) {
+            char aminoAcid = lookupResidue(name);
+            checksum += (aminoAcid == UNKNOWN_RESIDUE ? '.' : aminoAcid) + isExcludedAminoAcid(aminoAcid);
+        }
+    });
+
+    PDBContext con;
+    double legacySeqres = nanosecondsPerResidue(seqresResidues, [&]() {
+        con.reset();
+        for (const auto *line : seqresLines)
+            legacy::processSequence(*line, con);
+    });
+    double seqres = nanosecondsPerResidue(seqresResidues, [&]() {
+        con.reset();
+        for (const auto *line : seqresLines)
+            processSequence(*line, con);
+    });
+
+    report.add("residues", names.size(), "residues");
+    report.add("SEQRES residues", seqresResidues, "residues");
+    report.add("map lookup", mapLookup, "ns/residue");
+    report.add("table lookup", tableLookup, "ns/residue", speedup(mapLookup / tableLookup));
+    report.add("legacy SEQRES parser", legacySeqres, "ns/residue");
+    report.add("SEQRES parser", seqres, "ns/residue", speedup(legacySeqres / seqres));
+
+    keepAlive(checksum);
+    return 0;
+}
+
+int benchmarkNeighbours(const std::vector<std::string> &paths, int repeats, BenchmarkReport &report) {
+    Corpus corpus = loadCorpus(paths);
+
+    // coordinates of the successfully parsed structures
+    std::vector<ResidueCoordinates> structures;
+    size_t residueCount = 0;
+    std::ostringstream discard;
+    for (const auto &file : corpus.files) {
+        PDBContext con;
+        std::istringstream in(file);
+        if (processPDBStream(in, discard, con) == SUCCESS) {
+            residueCount += con.output.size();
+            structures.push_back(con.output);
+        }
+    }
+
+    if (structures.empty()) {
+        std::cerr << "No valid PDB files found." << std::endl;
+        return 1;
+    }
+
+    report.add("structures", structures.size(), "structures");
+    report.add("residues", residueCount, "residues");
+
+    NeighbourGrid grid;
+    std::string scalarKmers;
+    for (const char *name : {"scalar", "avx2", "avx512"}) {
+        DistanceFilter filter = selectDistanceFilter(name);
+        if (!filter) {
+            report.addNote(name, "not supported by this CPU");
+            continue;
+        }
+        grid.setDistanceFilter(filter);
+
+        std::ostringstream kmers;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; ++i) {
+            kmers.str("");
+            for (const auto &structure : structures) {
+                grid.build(structure, KMER_RADIUS);
+                grid.writeKmers(kmers);
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (scalarKmers.empty())
+            scalarKmers = kmers.str();
+        report.add(name, residueCount * static_cast<double>(repeats) / seconds, "residues/s",
+                   kmers.str() == scalarKmers ? "" : "k-mers differ from scalar!");
+    }
+    return 0;
+}
+
+// Merges and sorts the k-mers of every size in sizes, and writes them to out,
+// as post_process_kmers does for a single thread.
+template <typename Key>
+void writeAllSizes(SizeTables<Key> &sizes, std::ostream &out) {
+    for (size_t i = 0; i < sizes.tables.size(); ++i) {
+        std::vector<PartitionedKmerTable<Key>> threadKmers;
+        threadKmers.push_back(std::move(sizes.tables[i]));
+        writeKmers(threadKmers, sizes.first + static_cast<int>(i), 0, out, 1, nullptr);
+    }
+}
+
+// Proximity k-mers per second counted into the tables of post_process_kmers,
+// and then sorted and written, on one thread, over the k-mers of the valid
+// structures.
+int benchmarkCount(const std::vector<std::string> &paths, int repeats, const CountOptions &options,
+                   BenchmarkReport &report) {
+    Corpus corpus = loadCorpus(paths);
+
+    std::ostringstream kmerText;
+    std::ostringstream discard;
+    NeighbourGrid grid;
+    size_t structureCount = 0;
+    for (const auto &file : corpus.files) {
+        PDBContext con;
+        std::istringstream in(file);
+        if (processPDBStream(in, discard, con) == SUCCESS) {
+            grid.build(con.output, KMER_RADIUS);
+            grid.writeKmers(kmerText);
+            ++structureCount;
+        }
+    }
+
+    const std::string kmers = kmerText.str();
+    const size_t kmerCount = std::count(kmers.begin(), kmers.end(), '\n');
+    if (kmerCount == 0) {
+        std::cerr << "No valid PDB files found." << std::endl;
+        return 1;
+    }
+
+    double countSeconds = 0, writeSeconds = 0;
+    std::ostringstream out;
+    for (int i = 0; i < repeats; ++i) {
+        KmerCounts counts(options);
+        countSeconds += measureSeconds(1, [&]() { countKmerLines(kmers, counts); });
+        out.str("");
+        writeSeconds += measureSeconds(1, [&]() {
+            writeAllSizes(counts.packed, out);
+            writeAllSizes(counts.widePacked, out);
+            writeAllSizes(counts.strings, out);
+        });
+    }
+
+    report.add("structures", structureCount, "structures");
+    report.add("k-mers", kmerCount, "k-mers");
+    report.add("k-mer sizes", options.max_kmer_size - options.min_kmer_size + 1, "sizes",
+               std::to_string(options.min_kmer_size) + "-" + std::to_string(options.max_kmer_size));
+    report.add("count", kmerCount * static_cast<double>(repeats) / countSeconds, "k-mers/s");
+    report.add("sort and write", kmerCount * static_cast<double>(repeats) / writeSeconds, "k-mers/s");
+    return 0;
+}
+
+// Path for a temporary file of the benchmarks; unique per process.
+std::string temporaryPath(const std::string &name) {
+    static const std::string prefix = "kmers-benchmark-" + std::to_string(
+        std::chrono::steady_clock::now().time_since_epoch().count()) + "-";
+    return (std::filesystem::temp_directory_path() / (prefix + name)).string();
+}
+
+// Rows per second of parsing UniProt FASTA, and of loading the parsed records
+// into each target of fasta_to_sqlite.
+int benchmarkFasta(const std::vector<std::string> &paths, int repeats, BenchmarkReport &report) {
+    std::vector<std::vector<Record>> batches;
+    size_t bytes = 0;
+    std::string error;
+    double parseSeconds = measureSeconds(repeats, [&]() {
+        batches.clear();
+        bytes = 0;
+        auto onBatch = [&](std::vector<Record> &&batch) { batches.push_back(std::move(batch)); };
+        FastaParser<decltype(onBatch)> fasta(FASTA_BATCH_SIZE, onBatch);
+        for (const auto &path : paths) {
+            auto consume = [&](std::string_view block) {
+                bytes += block.size();
+                fasta.consume(block);
+                return true;
+            };
+            if (!readInput(path, 1, consume, error))
+                break;
+            fasta.finish();
+        }
+    });
+    if (!error.empty()) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    size_t rows = 0;
+    for (const auto &batch : batches)
+        rows += batch.size();
+    if (rows == 0) {
+        std::cerr << "No FASTA records found." << std::endl;
+        return 1;
+    }
+
+    report.add("records", rows, "rows");
+    report.add("FASTA", bytes / 1e6, "MB");
+    report.add("FASTA parser", rows / parseSeconds, "rows/s");
+
+    // SQLite, keyed table committed per batch (default), and bulk load
+    for (bool bulk : {false, true}) {
+        std::string path = temporaryPath("sequences.db");
+        bool ok = true;
+        double seconds = measureSeconds(repeats, [&]() {
+            std::filesystem::remove(path);
+            SequenceDatabase db;
+            ok = ok && db.open(path, bulk, error);
+            for (const auto &batch : batches)
+                ok = ok && db.insert(batch, error);
+            ok = ok && db.finishLoad(error);
+        });
+        std::filesystem::remove(path);
+        if (!ok) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        report.add(bulk ? "SQLite bulk load" : "SQLite insert", rows / seconds, "rows/s");
+    }
+
+    std::string path = temporaryPath("sequences.store");
+    bool ok = true;
+    double seconds = measureSeconds(repeats, [&]() {
+        SequenceStoreWriter store;
+        ok = ok && store.open(path, error);
+        for (const auto &batch : batches)
+            ok = ok && store.add(batch, error);
+        ok = ok && store.finish(error);
+    });
+    std::filesystem::remove(path);
+    if (!ok) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    report.add("sequence store", rows / seconds, "rows/s");
+    return 0;
+}
+
+int generateCorpus(const std::string &directory, const SyntheticOptions &options, SyntheticCorpus &corpus,
+                   BenchmarkReport &report) {
+    std::string error;
+    auto start = std::chrono::steady_clock::now();
+    if (!generateSyntheticCorpus(directory, options, corpus, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    report.add("files", corpus.files, "files", corpus.pdbDirectory);
+    report.add("PDB", corpus.pdbBytes / 1e6, "MB", "decompressed");
+    report.add("FASTA records", corpus.sequences, "records", corpus.fastaPath);
+    report.add("time", seconds, "s");
+    return 0;
+}
+
+void printUsage(const char *program) {
+    std::cerr << "Usage: " << program << " (parse | residues | neighbours | count) [options] PATH ...\n"
+              << "       " << program << " fasta [options] FILE ...\n"
+              << "       " << program << " generate [generator options] DIRECTORY\n"
+              << "       " << program << " suite [options] [generator options] [DIRECTORY]\n"
+              << "Benchmarks:\n"
+              << "  parse        Parse MB/s of PDB records, over .ent.gz files or directories\n"
+              << "  residues     Nanoseconds per residue of residue name lookup and SEQRES parsing\n"
+              << "  neighbours   Proximity k-mers per second, for each distance filter kernel\n"
+              << "  count        K-mers per second counted, and sorted and written, by post_process_kmers\n"
+              << "  fasta        Rows per second of parsing UniProt FASTA, and of loading it into\n"
+              << "               SQLite (keyed and --bulk) and a sequence store, as fasta_to_sqlite\n"
+              << "  generate     Write a synthetic corpus: DIRECTORY/pdb and DIRECTORY/uniprot.fasta\n"
+              << "               (an existing DIRECTORY/pdb is replaced)\n"
+              << "  suite        Generate a synthetic corpus (in DIRECTORY, kept, or a temporary\n"
+              << "               directory) and run every benchmark over it\n"
+              << "Options:\n"
+              << "  -r <repeats>    Number of passes over the input (default=5)\n"
+              << "  -k <size>       K-mer size, or range MIN-MAX, for count (default=12)\n"
+              << "  --json          Print the results as JSON\n"
+              << "  -h, --help      Display this help message and exit\n"
+              << "Generator options:\n"
+              << "  --files <n>             PDB entries (default=200)\n"
+              << "  --chains <n>            Chains per entry (default=2)\n"
+              << "  --residues <n>          Residues per chain, at most 9999 (default=300)\n"
+              << "  --models <n>            Models per entry (default=1)\n"
+              << "  --remarks <n>           REMARK 3 lines per entry (default=100)\n"
+              << "  --dbref <fraction>      Entries with DBREF records (default=0.8)\n"
+              << "  --dbref1 <fraction>     Entries with DBREF1/DBREF2 records (default=0.1)\n"
+              << "  --low-resolution <fraction>\n"
+              << "                          Entries with a resolution above 2.5 (default=0.1)\n"
+              << "  --extra-sequences <n>   FASTA records no entry refers to (default=1000)\n"
+              << "  --seed <n>              Random seed (default=1)\n";
+}
+
+int main(int argc, char const *argv[]) {
+    std::ios_base::sync_with_stdio(false);
+
+    if (argc < 2 || std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help") {
+        printUsage(argv[0]);
+        return argc < 2;
+    }
+
+    std::string benchmark = argv[1];
+    int repeats = 5;
+    bool json = false;
+    CountOptions countOptions;
+    SyntheticOptions syntheticOptions;
+    std::vector<std::string> paths;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-r" && hasValue) {
+            repeats = std::stoi(argv[++i]);
+        } else if (arg == "-k" && hasValue) {
+            if (!parseKmerSizes(argv[++i], countOptions)) {
+                std::cerr << "Invalid k-mer size: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--json") {
+            json = true;
+        } else if (arg == "--files" && hasValue) {
+            syntheticOptions.files = std::stoul(argv[++i]);
+        } else if (arg == "--chains" && hasValue) {
+            syntheticOptions.chains = std::clamp(std::stoi(argv[++i]), 1, 26);
+        } else if (arg == "--residues" && hasValue) {
+            syntheticOptions.residues = std::clamp(std::stoi(argv[++i]), 1, 9999);
+        } else if (arg == "--models" && hasValue) {
+            syntheticOptions.models = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--remarks" && hasValue) {
+            syntheticOptions.remarks = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--dbref" && hasValue) {
+            syntheticOptions.dbrefFraction = std::stod(argv[++i]);
+        } else if (arg == "--dbref1" && hasValue) {
+            syntheticOptions.dbref1Fraction = std::stod(argv[++i]);
+        } else if (arg == "--low-resolution" && hasValue) {
+            syntheticOptions.lowResolutionFraction = std::stod(argv[++i]);
+        } else if (arg == "--extra-sequences" && hasValue) {
+            syntheticOptions.extraSequences = std::stoul(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            syntheticOptions.seed = std::stoull(argv[++i]);
+        } else if (arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    std::vector<BenchmarkReport> reports;
+    auto run = [&](const std::string &name, auto benchmarkFunction) {
+        reports.emplace_back(name);
+        return benchmarkFunction(reports.back());
+    };
+
+    int result = 0;
+    if (benchmark == "parse") {
+        result = run("parse", [&](BenchmarkReport &report) { return benchmarkParse(paths, repeats, report); });
+    } else if (benchmark == "residues") {
+        result = run("residues", [&](BenchmarkReport &report) { return benchmarkResidues(paths, repeats, report); });
+    } else if (benchmark == "neighbours") {
+        result = run("neighbours", [&](BenchmarkReport &report) {
+            return benchmarkNeighbours(paths, repeats, report);
+        });
+    } else if (benchmark == "count") {
+        result = run("count", [&](BenchmarkReport &report) {
+            return benchmarkCount(paths, repeats, countOptions, report);
+        });
+    } else if (benchmark == "fasta") {
+        result = run("fasta", [&](BenchmarkReport &report) { return benchmarkFasta(paths, repeats, report); });
+    } else if (benchmark == "generate" || benchmark == "suite") {
+        if (paths.size() > 1 || (benchmark == "generate" && paths.empty())) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        const bool keep = !paths.empty();
+        const std::string directory = keep ? paths[0] : temporaryPath("corpus");
+
+        SyntheticCorpus corpus;
+        result = run("generate", [&](BenchmarkReport &report) {
+            return generateCorpus(directory, syntheticOptions, corpus, report);
+        });
+
+        if (result == 0 && benchmark == "suite") {
+            std::vector<std::string> pdbPaths = {corpus.pdbDirectory};
+            std::vector<std::string> fastaPaths = {corpus.fastaPath};
+            result = run("parse", [&](BenchmarkReport &report) { return benchmarkParse(pdbPaths, repeats, report); })
+                || run("residues", [&](BenchmarkReport &report) {
+                       return benchmarkResidues(pdbPaths, repeats, report);
+                   })
+                || run("neighbours", [&](BenchmarkReport &report) {
+                       return benchmarkNeighbours(pdbPaths, repeats, report);
+                   })
+                || run("count", [&](BenchmarkReport &report) {
+                       return benchmarkCount(pdbPaths, repeats, countOptions, report);
+                   })
+                || run("fasta", [&](BenchmarkReport &report) {
+                       return benchmarkFasta(fastaPaths, repeats, report);
+                   });
+        }
+        if (!keep)
+            std::filesystem::remove_all(directory);
+    } else {
+        std::cerr << "Unknown benchmark: " << benchmark << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (result == 0)
+        BenchmarkReport::print(reports, json, std::cout);
+    return result;
+}
@@ -1,29 +1,31 @@
 #ifndef ATOMDATAPARSER_H
 #define ATOMDATAPARSER_H
 
-#include <string>
-#include <sstream>
+#include <string_view>
 
+#include "PDBRecord.h"
+
+// Fields of an ATOM record; parsed in place, the record line has to outlive it.
 struct AtomData
 {
     bool isValidAtom; // whether the atom is valid (CA)
-    std::string resName; // residue name (AA)
+    std::string_view resName; // residue name (AA)
+    char chainId; // chain identifier
     int resSeq; // residue sequence number
     float x, y, z;
 
-    AtomData(const std::string& str, size_t offset = 0)
+    AtomData(std::string_view str)
     {
-        std::string atom_name = str.substr(-offset + 12, 4);
-    
-        isValidAtom = atom_name == " CA "; // whether the atom is ca
+        isValidAtom = field(str, 12, 4) == " CA "; // whether the atom is ca
         if (!isValidAtom)
             return;
 
-        resName = str.substr(-offset + 17, 3);
-        resSeq = std::stoi(str.substr(-offset + 22, 4));
-        x = std::stof(str.substr(-offset + 30, 8));
-        y = std::stof(str.substr(-offset + 38, 8));
-        z = std::stof(str.substr(-offset + 46, 8));
+        resName = field(str, 17, 3);
+        chainId = str.size() > 21 ? str[21] : ' ';
+        isValidAtom = parseInt(field(str, 22, 4), resSeq)
+            && parseFloat(field(str, 30, 8), x)
+            && parseFloat(field(str, 38, 8), y)
+            && parseFloat(field(str, 46, 8), z);
     }
 };
 
@@ -0,0 +1,216 @@
+#include "BatchProcessor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <iomanip>
+#include <istream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "Constants.h"
+#include "GZStreamBuf.h"
+#include "PDBContext.h"
+#include "PDBParser.h"
+#include "RecordFormat.h"
+
+namespace fs = std::filesystem;
+
+// files a worker may run ahead of the output, per thread
+const size_t FRAME_WINDOW_PER_THREAD = 4;
+
+// Per-thread state, kept between files so that parsing a file does not
+// allocate new buffers.
+struct BatchWorker {
+    GZStreamBuf gzBuffer;
+    std::istream in{&gzBuffer};
+    std::ostringstream body;
+    PDBContext con;
+    StageClock clock{MAX_EXTRACT_STAGES};
+    RunStats *stats = nullptr;
+
+    // throughput statistics
+    size_t fileCount = 0;
+    size_t successCount = 0;
+    size_t bytesRead = 0;
+    double busySeconds = 0;
+
+    // Parses file and stores its frame (header and body) in frame.
+    void processFile(const std::string &file, std::string &frame);
+};
+
+bool isPDBFile(const fs::path &path) {
+    const std::string extension = ".ent.gz";
+    const std::string name = path.filename().string();
+    return name.size() >= extension.size()
+        && name.compare(name.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+std::vector<std::string> collectInputFiles(const std::vector<std::string> &paths) {
+    std::vector<std::string> files;
+
+    for (const auto &path : paths) {
+        if (!fs::is_directory(path)) {
+            files.push_back(path);
+            continue;
+        }
+
+        for (const auto &entry : fs::recursive_directory_iterator(path)) {
+            if (entry.is_regular_file() && isPDBFile(entry.path()))
+                files.push_back(entry.path().string());
+        }
+    }
+
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+void BatchWorker::processFile(const std::string &file, std::string &frame) {
+    auto start = std::chrono::steady_clock::now();
+    PDBParsingCode code = FILE_NOT_READABLE;
+    body.str("");
+    con.sourcePath = file;
+    if (stats) {
+        clock.reset();
+        clock.switchTo(STAGE_OPEN);
+    }
+
+    if (gzBuffer.open(file)) {
+        in.clear();
+        try {
+            code = processPDBStream(in, body, con);
+        } catch (const std::exception &e) {
+            body.str("");
+            body << e.what() << '\n';
+            code = UNEXPECTED_ERROR;
+        }
+
+        if (gzBuffer.hasError())
+            code = FILE_NOT_READABLE;
+        bytesRead += gzBuffer.bytesRead();
+        gzBuffer.close();
+    }
+
+    if (con.options.format == OutputFormat::BINARY) {
+        // records carry their own code and path; files that were not parsed
+        // to the end get a record without data
+        if (code == FILE_NOT_READABLE || code == UNEXPECTED_ERROR) {
+            body.str("");
+            writeRecord(code, file, body);
+        }
+        frame = body.str();
+    } else {
+        std::string bodyString = body.str();
+        frame = "frame: " + std::to_string(bodyString.size()) + ' ' + code_name[code] + ' ' + file + '\n';
+        frame += bodyString;
+    }
+
+    fileCount++;
+    if (code == SUCCESS)
+        successCount++;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    busySeconds += seconds;
+
+    if (stats) {
+        clock.count(STAGE_OUTPUT, 1, frame.size());
+        clock.stop();
+        stats->addItem(clock, code, seconds, file);
+    }
+}
+
+void printThroughput(const std::vector<BatchWorker> &workers, double wallSeconds, std::ostream &log) {
+    size_t totalFiles = 0, totalBytes = 0;
+    log << std::fixed << std::setprecision(2);
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        const auto &worker = workers[i];
+        double seconds = std::max(worker.busySeconds, 1e-9);
+        log << "thread " << i << ": " << worker.fileCount << " files, "
+            << worker.bytesRead / 1e6 << " MB in " << worker.busySeconds << " s; "
+            << worker.fileCount / seconds << " files/s, "
+            << worker.bytesRead / 1e6 / seconds << " MB/s\n";
+
+        totalFiles += worker.fileCount;
+        totalBytes += worker.bytesRead;
+    }
+
+    wallSeconds = std::max(wallSeconds, 1e-9);
+    log << "total: " << totalFiles << " files, " << totalBytes / 1e6 << " MB in " << wallSeconds << " s; "
+        << totalFiles / wallSeconds << " files/s, " << totalBytes / 1e6 / wallSeconds << " MB/s" << std::endl;
+}
+
+size_t processFiles(const std::vector<std::string> &files, const ParserOptions &options,
+                    std::ostream &out, unsigned int threadCount, std::ostream &log, RunStats *stats) {
+    auto start = std::chrono::steady_clock::now();
+    threadCount = std::max(1u, threadCount);
+
+    std::vector<BatchWorker> workers(threadCount);
+    for (auto &worker : workers) {
+        worker.con.options = options;
+        if (stats) {
+            worker.stats = stats;
+            worker.con.clock = &worker.clock;
+            worker.gzBuffer.setClock(&worker.clock, STAGE_INFLATE);
+        }
+    }
+    std::atomic<size_t> nextFile{0};
+
+    // frames are handed from the workers to this thread, which writes them in
+    // input order; workers do not start a file more than window files ahead
+    // of the last one written, so that a slow file holds back a bounded
+    // number of finished frames
+    const size_t window = FRAME_WINDOW_PER_THREAD * threadCount;
+    std::vector<std::string> frames(files.size());
+    std::vector<char> ready(files.size(), false);
+    size_t written = 0;
+    std::mutex frameMutex;
+    std::condition_variable frameReady;
+
+    auto work = [&](BatchWorker &worker) {
+        std::string frame;
+        for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+            {
+                std::unique_lock<std::mutex> lock(frameMutex);
+                frameReady.wait(lock, [&] { return i < written + window; });
+            }
+            worker.processFile(files[i], frame);
+            {
+                std::lock_guard<std::mutex> lock(frameMutex);
+                frames[i] = std::move(frame);
+                ready[i] = true;
+            }
+            frameReady.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (auto &worker : workers)
+        threads.emplace_back(work, std::ref(worker));
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::string frame;
+        {
+            std::unique_lock<std::mutex> lock(frameMutex);
+            frameReady.wait(lock, [&] { return ready[i]; });
+            frame = std::move(frames[i]);
+            written = i + 1;
+        }
+        frameReady.notify_all();
+        out << frame;
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+    out.flush();
+
+    size_t successCount = 0;
+    for (const auto &worker : workers)
+        successCount += worker.successCount;
+
+    printThroughput(workers, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), log);
+    return successCount;
+}
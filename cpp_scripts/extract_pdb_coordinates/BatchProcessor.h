@@ -0,0 +1,29 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "PDBContext.h"
+#include "RunStats.h"
+
+// Expands the given paths into a sorted list of PDB files. Directories are
+// walked recursively for *.ent.gz files, other paths are taken as they are.
+std::vector<std::string> collectInputFiles(const std::vector<std::string> &paths);
+
+// Decompresses and parses every file on threadCount worker threads, writing
+// one frame per file to out, in the order of files. Each frame consists of a
+// header line
+//     frame: <body size in bytes> <parsing code> <file path>
+// followed by exactly <body size> bytes of processPDBStream output. With
+// OutputFormat::BINARY, the frames are the bare records (see RecordFormat.h);
+// the shard header is left to the caller.
+// Per-thread throughput is reported to log once all files are done, and
+// every file is timed by stage (ExtractStage) into stats, if given.
+// Returns the number of files parsed successfully.
+size_t processFiles(const std::vector<std::string> &files, const ParserOptions &options,
+                    std::ostream &out, unsigned int threadCount, std::ostream &log,
+                    RunStats *stats = nullptr);
+
+#endif // BATCHPROCESSOR_H
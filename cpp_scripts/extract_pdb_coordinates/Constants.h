@@ -1,9 +1,10 @@
 #ifndef CONSTANTS_H
 #define CONSTANTS_H
 
-#include <unordered_map>
-#include <unordered_set>
+#include <array>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 #define PDB_PARSING_CODES \
 X(SUCCESS, "SUCCESS") \
@@ -16,6 +17,8 @@ X(EXCLUDE_UNKNOWN_OR_RARE_AMINO_ACIDS, "EXCLUDE_UNKNOWN_OR_RARE_AMINO_ACIDS") \
 X(HAS_UNKNOWN_RESIDUE, "HAS_UNKNOWN_RESIDUE") \
 X(INVALID_SEQUENCE, "INVALID_SEQUENCE") \
 X(NO_UNIPROT_ID, "NO_UNIPROT_ID") \
+X(FILE_NOT_READABLE, "FILE_NOT_READABLE") \
+X(UNEXPECTED_ERROR, "UNEXPECTED_ERROR") \
 
 #define X(code, name) code,
 enum PDBParsingCode : size_t {
@@ -26,6 +29,31 @@ enum PDBParsingCode : size_t {
 
 extern const char *code_name[MAX_PDB_PARSING_CODES];
 
+// stages of extracting a PDB file that --stats times (see RunStats.h); the
+// record type stages hold the time spent on those lines, and their count
+#define EXTRACT_STAGES \
+X(STAGE_OPEN, "open") \
+X(STAGE_INFLATE, "inflate") \
+X(STAGE_HEADER, "HEADER") \
+X(STAGE_REMARK, "REMARK") \
+X(STAGE_DBREF, "DBREF") \
+X(STAGE_SEQRES, "SEQRES") \
+X(STAGE_ATOM, "ATOM") \
+X(STAGE_TER, "TER") \
+X(STAGE_OTHER_RECORDS, "other records") \
+X(STAGE_UNIPROT_MATCH, "UniProt match") \
+X(STAGE_NEIGHBOURS, "neighbours") \
+X(STAGE_OUTPUT, "output") \
+
+#define X(stage, name) stage,
+enum ExtractStage : size_t {
+    EXTRACT_STAGES
+    MAX_EXTRACT_STAGES
+};
+#undef X
+
+extern const char *stage_name[MAX_EXTRACT_STAGES];
+
 enum ResidueConfirmation {
     RESIDUE_VALID,
     RESIDUE_DUPLICATE, // same residue multiple times (e.g. multiple confirmation)
@@ -35,8 +63,81 @@ enum ResidueConfirmation {
 enum PDBType {PROTEIN, DNA, RNA, MISC};
 
 extern const float MAX_RESOLUTION;
-extern const std::unordered_map<std::string, char> aminoAcidLookup;
-extern const std::unordered_set<char> invalidAminoAcids;
+extern const float KMER_RADIUS;
+
+// One-letter amino acid codes of residue names.
+struct ResidueCode {
+    const char *name;
+    char aminoAcid;
+};
+
+inline constexpr ResidueCode RESIDUE_CODES[] = {
+    {"ALA", 'A'}, {"ARG", 'R'}, {"ASN", 'N'}, {"ASP", 'D'},
+    {"CYS", 'C'}, {"GLN", 'Q'}, {"GLU", 'E'}, {"GLY", 'G'},
+    {"HIS", 'H'}, {"HIP", 'H'}, {"HIE", 'H'}, {"ILE", 'I'},
+    {"LEU", 'L'}, {"LYS", 'K'}, {"MET", 'M'}, {"PHE", 'F'},
+    {"PRO", 'P'}, {"SER", 'S'}, {"THR", 'T'}, {"TYR", 'Y'},
+    {"TRP", 'W'}, {"VAL", 'V'}, {"SEC", 'U'}, {"PYL", 'O'},
+    {"XPL", 'O'}, // for pdb 1L2Q
+    {"GLX", 'Z'}, // for pdb 1KP0
+    {"ASX", 'B'}, // for pdb 1KP0
+    {"UNK", '.'} // unknown AA
+};
+
+// returned by lookupResidue for names not in RESIDUE_CODES
+constexpr char UNKNOWN_RESIDUE = '\0';
+
+// Residue names of three upper case letters are packed at 5 bits per letter
+// (A = 1), and index a table of their one-letter codes, built at compile
+// time; every other name packs to 0, which is UNKNOWN_RESIDUE.
+constexpr size_t RESIDUE_TABLE_SIZE = 1 << 15;
+
+constexpr uint32_t packResidueLetter(char c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 1 : 0;
+}
+
+constexpr uint32_t packResidueName(std::string_view name) {
+    if (name.size() != 3)
+        return 0;
+    uint32_t first = packResidueLetter(name[0]);
+    uint32_t second = packResidueLetter(name[1]);
+    uint32_t third = packResidueLetter(name[2]);
+    if (!first || !second || !third)
+        return 0;
+    return first << 10 | second << 5 | third;
+}
+
+constexpr std::array<char, RESIDUE_TABLE_SIZE> buildResidueTable() {
+    std::array<char, RESIDUE_TABLE_SIZE> table{};
+    for (const auto &residue : RESIDUE_CODES)
+        table[packResidueName(residue.name)] = residue.aminoAcid;
+    return table;
+}
+
+inline constexpr std::array<char, RESIDUE_TABLE_SIZE> RESIDUE_TABLE = buildResidueTable();
+
+// One-letter code of a residue name, or UNKNOWN_RESIDUE.
+constexpr char lookupResidue(std::string_view name) {
+    return RESIDUE_TABLE[packResidueName(name)];
+}
+
+// One bit per one-letter code (and '.'), by its low 6 bits, which differ for
+// all of them.
+constexpr uint64_t aminoAcidBit(char aminoAcid) {
+    return uint64_t(1) << (aminoAcid & 63);
+}
+
+// rare amino acids = SELENOCYSTEINE, PYRROLYSINE, GLX, ASX, & unknown AA
+inline constexpr uint64_t EXCLUDED_AMINO_ACIDS =
+    aminoAcidBit('U') | aminoAcidBit('O') | aminoAcidBit('Z') | aminoAcidBit('B') | aminoAcidBit('.');
+
+constexpr bool isExcludedAminoAcid(char aminoAcid) {
+    return EXCLUDED_AMINO_ACIDS & aminoAcidBit(aminoAcid);
+}
+
+static_assert(lookupResidue("ALA") == 'A' && lookupResidue("HIE") == 'H' && lookupResidue("UNK") == '.');
+static_assert(lookupResidue("DA") == UNKNOWN_RESIDUE && lookupResidue("0A1") == UNKNOWN_RESIDUE);
+static_assert(isExcludedAminoAcid('U') && isExcludedAminoAcid('.') && !isExcludedAminoAcid('A'));
 
 #endif // CONSTANTS_H
 
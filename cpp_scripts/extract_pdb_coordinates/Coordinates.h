@@ -0,0 +1,60 @@
+#ifndef COORDINATES_H
+#define COORDINATES_H
+
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+
+// Allocator for vectors whose data has to be aligned for SIMD loads.
+template <typename T, size_t Alignment>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T *p, size_t) {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+// 64 bytes: one cache line, and one AVX-512 register
+using AlignedFloats = std::vector<float, AlignedAllocator<float, 64>>;
+
+// Alpha carbons of a chain, as a structure of arrays.
+struct ResidueCoordinates {
+    std::string aminoAcids;
+    AlignedFloats x, y, z;
+
+    size_t size() const { return aminoAcids.size(); }
+
+    void push_back(char aminoAcid, float px, float py, float pz) {
+        aminoAcids += aminoAcid;
+        x.push_back(px);
+        y.push_back(py);
+        z.push_back(pz);
+    }
+
+    void clear() {
+        aminoAcids.clear();
+        x.clear();
+        y.clear();
+        z.clear();
+    }
+};
+
+#endif // COORDINATES_H
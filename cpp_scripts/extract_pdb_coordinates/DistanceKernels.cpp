@@ -0,0 +1,117 @@
+#include "DistanceKernels.h"
+
+#include <cstring>
+
+// The kernels have to round exactly like the scalar loop, so multiplies and
+// adds are not fused into FMA instructions (which AVX-512 implies), also when
+// optimizing.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+size_t filterByDistanceScalar(const float *x, const float *y, const float *z,
+                              size_t begin, size_t end, float qx, float qy, float qz,
+                              float radiusSquared, float *distances, uint32_t *positions) {
+    size_t count = 0;
+    for (size_t i = begin; i < end; ++i) {
+        float dx = x[i] - qx, dy = y[i] - qy, dz = z[i] - qz;
+        float distanceSquared = (dx * dx + dy * dy) + dz * dz;
+        if (distanceSquared <= radiusSquared) {
+            distances[count] = distanceSquared;
+            positions[count++] = i;
+        }
+    }
+    return count;
+}
+
+#ifdef HAS_X86_KERNELS
+
+__attribute__((target("avx2")))
+size_t filterByDistanceAVX2(const float *x, const float *y, const float *z,
+                            size_t begin, size_t end, float qx, float qy, float qz,
+                            float radiusSquared, float *distances, uint32_t *positions) {
+    const __m256 vqx = _mm256_set1_ps(qx), vqy = _mm256_set1_ps(qy), vqz = _mm256_set1_ps(qz);
+    const __m256 vradius = _mm256_set1_ps(radiusSquared);
+
+    size_t count = 0, i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), vqx);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), vqy);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + i), vqz);
+        __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                                 _mm256_mul_ps(dz, dz));
+
+        unsigned mask = _mm256_movemask_ps(_mm256_cmp_ps(d, vradius, _CMP_LE_OQ));
+        if (!mask)
+            continue;
+
+        alignas(32) float lane[8];
+        _mm256_store_ps(lane, d);
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            distances[count] = lane[bit];
+            positions[count++] = i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    return count + filterByDistanceScalar(x, y, z, i, end, qx, qy, qz, radiusSquared,
+                                          distances + count, positions + count);
+}
+
+__attribute__((target("avx512f")))
+size_t filterByDistanceAVX512(const float *x, const float *y, const float *z,
+                              size_t begin, size_t end, float qx, float qy, float qz,
+                              float radiusSquared, float *distances, uint32_t *positions) {
+    const __m512 vqx = _mm512_set1_ps(qx), vqy = _mm512_set1_ps(qy), vqz = _mm512_set1_ps(qz);
+    const __m512 vradius = _mm512_set1_ps(radiusSquared);
+    const __m512i laneIndex = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    size_t count = 0, i = begin;
+    for (; i < end; i += 16) {
+        // the tail is handled by a masked load instead of a scalar loop
+        __mmask16 valid = end - i >= 16 ? 0xffff : static_cast<__mmask16>((1u << (end - i)) - 1);
+
+        __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(valid, x + i), vqx);
+        __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(valid, y + i), vqy);
+        __m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(valid, z + i), vqz);
+        __m512 d = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)),
+                                 _mm512_mul_ps(dz, dz));
+
+        __mmask16 inside = _mm512_mask_cmp_ps_mask(valid, d, vradius, _CMP_LE_OQ);
+        if (!inside)
+            continue;
+
+        __m512i index = _mm512_add_epi32(laneIndex, _mm512_set1_epi32(static_cast<int>(i)));
+        _mm512_mask_compressstoreu_ps(distances + count, inside, d);
+        _mm512_mask_compressstoreu_epi32(positions + count, inside, index);
+        count += __builtin_popcount(inside);
+    }
+
+    return count;
+}
+
+#endif // HAS_X86_KERNELS
+
+DistanceFilter selectDistanceFilter(const char *name) {
+    bool isAuto = std::strcmp(name, "auto") == 0;
+
+#ifdef HAS_X86_KERNELS
+    __builtin_cpu_init();
+    if ((isAuto || std::strcmp(name, "avx512") == 0) && __builtin_cpu_supports("avx512f"))
+        return filterByDistanceAVX512;
+    if ((isAuto || std::strcmp(name, "avx2") == 0) && __builtin_cpu_supports("avx2"))
+        return filterByDistanceAVX2;
+#endif
+
+    if (isAuto || std::strcmp(name, "scalar") == 0)
+        return filterByDistanceScalar;
+    return nullptr;
+}
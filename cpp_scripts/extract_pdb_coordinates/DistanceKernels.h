@@ -0,0 +1,26 @@
+#ifndef DISTANCEKERNELS_H
+#define DISTANCEKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Radius filter over a range of points held as separate x/y/z arrays: appends
+// the squared distance to (qx, qy, qz) and position of every point in
+// [begin, end) within radiusSquared to distances/positions, and returns the
+// number of points appended. Both outputs need room for end - begin values.
+//
+// All variants compute ((dx*dx + dy*dy) + dz*dz) in the same order, so they
+// select exactly the same points.
+using DistanceFilter = size_t (*)(const float *x, const float *y, const float *z,
+                                  size_t begin, size_t end, float qx, float qy, float qz,
+                                  float radiusSquared, float *distances, uint32_t *positions);
+
+size_t filterByDistanceScalar(const float *x, const float *y, const float *z,
+                              size_t begin, size_t end, float qx, float qy, float qz,
+                              float radiusSquared, float *distances, uint32_t *positions);
+
+// Selects a filter by name ("scalar", "avx2" or "avx512"), or the widest one
+// the CPU supports for "auto". Returns nullptr if the CPU lacks the named one.
+DistanceFilter selectDistanceFilter(const char *name = "auto");
+
+#endif // DISTANCEKERNELS_H
@@ -0,0 +1,156 @@
+#include "GZStreamBuf.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+// size of the first block of compressed input and of inflated data read from a
+// file; later blocks double in size, up to the buffer sizes
+const size_t GZ_INITIAL_BLOCK_SIZE = 1 << 12;
+
+// size of the buffer for compressed input
+const size_t GZ_INPUT_BUFFER_SIZE = 1 << 17;
+
+// windowBits for inflateInit2: a 32K window, gzip header and trailer
+const int GZ_WINDOW_BITS = 15 + 16;
+
+static bool isGzipMagic(const unsigned char *data, size_t size) {
+    return size >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+}
+
+GZStreamBuf::GZStreamBuf(size_t bufferSize) : input(GZ_INPUT_BUFFER_SIZE), buffer(bufferSize) {
+    if (inflateInit2(&stream, GZ_WINDOW_BITS) != Z_OK)
+        throw std::bad_alloc();
+    setg(buffer.data(), buffer.data(), buffer.data());
+}
+
+GZStreamBuf::~GZStreamBuf() {
+    close();
+    inflateEnd(&stream);
+}
+
+bool GZStreamBuf::open(const std::string &filename) {
+    close();
+
+    file = std::fopen(filename.c_str(), "rb");
+    if (!file)
+        return false;
+
+    inputBlockSize = GZ_INITIAL_BLOCK_SIZE;
+    blockSize = GZ_INITIAL_BLOCK_SIZE;
+    inflateReset(&stream);
+
+    // like gzread, files without a gzip header are read as they are
+    if (!fillInput())
+        finished = true; // empty
+    else
+        compressed = isGzipMagic(stream.next_in, stream.avail_in);
+    return true;
+}
+
+void GZStreamBuf::close() {
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+
+    stream.next_in = nullptr;
+    stream.avail_in = 0;
+    totalRead = 0;
+    compressed = true;
+    memberEnded = false;
+    finished = false;
+    failed = false;
+    setg(buffer.data(), buffer.data(), buffer.data());
+}
+
+bool GZStreamBuf::fillInput() {
+    size_t size = std::min(inputBlockSize, input.size());
+    inputBlockSize = std::min(inputBlockSize * 2, input.size());
+
+    size_t numRead = std::fread(input.data(), 1, size, file);
+    if (numRead == 0 && std::ferror(file))
+        failed = true;
+
+    stream.next_in = input.data();
+    stream.avail_in = static_cast<uInt>(numRead);
+    return numRead > 0;
+}
+
+// Inflates up to size bytes into the buffer; fewer only at the end of the
+// file, or on an error.
+size_t GZStreamBuf::inflateBlock(size_t size) {
+    stream.next_out = reinterpret_cast<Bytef *>(buffer.data());
+    stream.avail_out = static_cast<uInt>(size);
+
+    while (stream.avail_out > 0) {
+        if (stream.avail_in == 0 && !fillInput()) {
+            // the file may only end after a complete member
+            failed = failed || !memberEnded;
+            finished = true;
+            break;
+        }
+
+        if (memberEnded) {
+            // another member may follow; anything else is ignored, as by gzread
+            if (!isGzipMagic(stream.next_in, stream.avail_in)) {
+                finished = true;
+                break;
+            }
+            inflateReset(&stream);
+            memberEnded = false;
+        }
+
+        int status = inflate(&stream, Z_NO_FLUSH);
+        if (status == Z_STREAM_END) {
+            memberEnded = true;
+        } else if (status != Z_OK) { // corrupt input
+            failed = true;
+            finished = true;
+            break;
+        }
+    }
+    return size - stream.avail_out;
+}
+
+// Copies up to size bytes of an uncompressed file into the buffer.
+size_t GZStreamBuf::copyBlock(size_t size) {
+    size_t numRead = 0;
+    while (numRead < size) {
+        if (stream.avail_in == 0 && !fillInput()) {
+            finished = true;
+            break;
+        }
+
+        size_t chunk = std::min<size_t>(size - numRead, stream.avail_in);
+        std::memcpy(buffer.data() + numRead, stream.next_in, chunk);
+        stream.next_in += chunk;
+        stream.avail_in -= static_cast<uInt>(chunk);
+        numRead += chunk;
+    }
+    return numRead;
+}
+
+GZStreamBuf::int_type GZStreamBuf::underflow() {
+    if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+
+    if (!file || finished)
+        return traits_type::eof();
+
+    size_t size = std::min(blockSize, buffer.size());
+    blockSize = std::min(blockSize * 2, buffer.size());
+
+    size_t previousStage = clock ? clock->switchTo(clockStage) : 0;
+    size_t numRead = compressed ? inflateBlock(size) : copyBlock(size);
+    if (clock) {
+        clock->count(clockStage, 1, numRead);
+        clock->switchTo(previousStage);
+    }
+    if (numRead == 0) // end of file, or corrupt input
+        return traits_type::eof();
+
+    totalRead += numRead;
+    setg(buffer.data(), buffer.data(), buffer.data() + numRead);
+    return traits_type::to_int_type(*gptr());
+}
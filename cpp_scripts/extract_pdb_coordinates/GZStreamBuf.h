@@ -0,0 +1,68 @@
+#ifndef GZSTREAMBUF_H
+#define GZSTREAMBUF_H
+
+#include <cstdio>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "RunStats.h"
+
+// Stream buffer over a .gz file. Data is inflated block by block as the stream
+// is consumed, so a PDB is never held in memory in full. Blocks start small
+// and double up to the buffer size, so that a file the parser rejects from its
+// header (e.g. resolution too low) costs a few KB of reading and inflating,
+// rather than the whole file. Files that are not gzip compressed are read as
+// they are. The buffer can be reopened on another file, keeping its
+// allocations.
+class GZStreamBuf : public std::streambuf {
+public:
+    explicit GZStreamBuf(size_t bufferSize = 1 << 16);
+    ~GZStreamBuf() override;
+
+    GZStreamBuf(const GZStreamBuf&) = delete;
+    GZStreamBuf& operator=(const GZStreamBuf&) = delete;
+
+    bool open(const std::string &filename);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    // whether zlib reported an error (e.g. truncated or corrupt file)
+    bool hasError() const { return failed; }
+
+    // number of decompressed bytes read from the current file
+    size_t bytesRead() const { return totalRead; }
+
+    // Times inflating, as stage of clock, and counts the blocks and bytes
+    // inflated; nullptr to stop.
+    void setClock(StageClock *stageClock, size_t stage) {
+        clock = stageClock;
+        clockStage = stage;
+    }
+
+protected:
+    int_type underflow() override;
+
+private:
+    // reads the next block of compressed input; false at the end of the file
+    bool fillInput();
+    size_t inflateBlock(size_t size);
+    size_t copyBlock(size_t size);
+
+    std::FILE *file = nullptr;
+    z_stream stream{};
+    std::vector<unsigned char> input;
+    std::vector<char> buffer;
+    size_t inputBlockSize = 0;
+    size_t blockSize = 0;
+    size_t totalRead = 0;
+    bool compressed = true;
+    bool memberEnded = false; // inflate reached the end of a gzip member
+    bool finished = false;
+    bool failed = false;
+    StageClock *clock = nullptr;
+    size_t clockStage = 0;
+};
+
+#endif // GZSTREAMBUF_H
@@ -0,0 +1,118 @@
+#include "NeighbourGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+// upper bound for the number of cells per residue; sparse structures get
+// larger cells instead of an oversized grid
+const size_t MAX_CELLS_PER_RESIDUE = 8;
+
+void NeighbourGrid::build(const ResidueCoordinates &residues, float radius) {
+    this->residues = &residues;
+    this->radius = radius;
+    residueCells.clear();
+    cellResidues.clear();
+    cellStart.clear();
+
+    const size_t count = residues.size();
+    if (count == 0)
+        return;
+
+    const auto [minXIt, maxXIt] = std::minmax_element(residues.x.begin(), residues.x.end());
+    const auto [minYIt, maxYIt] = std::minmax_element(residues.y.begin(), residues.y.end());
+    const auto [minZIt, maxZIt] = std::minmax_element(residues.z.begin(), residues.z.end());
+    minX = *minXIt, minY = *minYIt, minZ = *minZIt;
+    const float maxX = *maxXIt, maxY = *maxYIt, maxZ = *maxZIt;
+
+    cellSize = radius;
+    const double maxCells = static_cast<double>(MAX_CELLS_PER_RESIDUE) * count + 27;
+    auto cellCount = [&]() {
+        return (std::floor((maxX - minX) / cellSize) + 1) * (std::floor((maxY - minY) / cellSize) + 1)
+            * (std::floor((maxZ - minZ) / cellSize) + 1);
+    };
+    while (cellCount() > maxCells)
+        cellSize *= 2;
+
+    dimX = static_cast<int>((maxX - minX) / cellSize) + 1;
+    dimY = static_cast<int>((maxY - minY) / cellSize) + 1;
+    dimZ = static_cast<int>((maxZ - minZ) / cellSize) + 1;
+
+    // counting sort of the residues by cell
+    cellStart.assign(static_cast<size_t>(dimX) * dimY * dimZ + 1, 0);
+    residueCells.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        int cx = std::min(static_cast<int>((residues.x[i] - minX) / cellSize), dimX - 1);
+        int cy = std::min(static_cast<int>((residues.y[i] - minY) / cellSize), dimY - 1);
+        int cz = std::min(static_cast<int>((residues.z[i] - minZ) / cellSize), dimZ - 1);
+        residueCells[i] = cellIndex(cx, cy, cz);
+        cellStart[residueCells[i] + 1]++;
+    }
+
+    for (size_t cell = 1; cell < cellStart.size(); ++cell)
+        cellStart[cell] += cellStart[cell - 1];
+
+    cellResidues.resize(count);
+    cellX.resize(count), cellY.resize(count), cellZ.resize(count);
+    cellFill.assign(cellStart.begin(), cellStart.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t position = cellFill[residueCells[i]]++;
+        cellResidues[position] = i;
+        cellX[position] = residues.x[i];
+        cellY[position] = residues.y[i];
+        cellZ[position] = residues.z[i];
+    }
+
+    candidateDistances.resize(count);
+    candidatePositions.resize(count);
+}
+
+void NeighbourGrid::findNeighbours(size_t i, std::vector<std::pair<float, uint32_t>> &found, size_t maxCount) {
+    const float qx = residues->x[i], qy = residues->y[i], qz = residues->z[i];
+    const float radiusSquared = radius * radius;
+
+    const int cx = residueCells[i] % dimX;
+    const int cy = residueCells[i] / dimX % dimY;
+    const int cz = residueCells[i] / dimX / dimY;
+
+    size_t candidates = 0;
+    for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, dimZ - 1); ++z) {
+        for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, dimY - 1); ++y) {
+            // cells adjacent in x are contiguous
+            size_t begin = cellStart[cellIndex(std::max(cx - 1, 0), y, z)];
+            size_t end = cellStart[cellIndex(std::min(cx + 1, dimX - 1), y, z) + 1];
+
+            candidates += filterByDistance(cellX.data(), cellY.data(), cellZ.data(), begin, end,
+                                           qx, qy, qz, radiusSquared,
+                                           candidateDistances.data() + candidates,
+                                           candidatePositions.data() + candidates);
+        }
+    }
+
+    found.resize(candidates);
+    for (size_t k = 0; k < candidates; ++k)
+        found[k] = {candidateDistances[k], cellResidues[candidatePositions[k]]};
+
+    if (maxCount > 0 && maxCount < found.size()) {
+        std::partial_sort(found.begin(), found.begin() + maxCount, found.end());
+        found.resize(maxCount);
+    } else {
+        std::sort(found.begin(), found.end());
+    }
+}
+
+const std::string &NeighbourGrid::kmer(size_t i, size_t maxLength) {
+    findNeighbours(i, found, maxLength);
+
+    kmerBuffer.clear();
+    for (const auto &[_distance, neighbour] : found)
+        kmerBuffer += residues->aminoAcids[neighbour];
+    return kmerBuffer;
+}
+
+void NeighbourGrid::writeKmers(std::ostream &out, size_t maxLength) {
+    for (size_t i = 0; i < residues->size(); ++i) {
+        const std::string &line = kmer(i, maxLength);
+        out.write(line.data(), line.size());
+        out.put('\n');
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef NEIGHBOURGRID_H
+#define NEIGHBOURGRID_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Coordinates.h"
+#include "DistanceKernels.h"
+
+// Uniform grid (cell list) over the alpha carbons of a structure, for radius
+// queries. With cells at least as large as the search radius, all neighbours
+// of a residue lie in the 27 cells around its own. Coordinates are copied in
+// cell order, so that each row of 3 adjacent cells is one contiguous range
+// for the SIMD distance filter.
+class NeighbourGrid {
+public:
+    NeighbourGrid() : filterByDistance(selectDistanceFilter()) {}
+
+    void setDistanceFilter(DistanceFilter filter) { filterByDistance = filter; }
+
+    void build(const ResidueCoordinates &residues, float radius);
+
+    // Residues within the radius of residue i (itself included), as pairs of
+    // squared distance and index, sorted by distance (ties by index). With
+    // maxCount > 0, only the closest maxCount residues are sorted and kept.
+    void findNeighbours(size_t i, std::vector<std::pair<float, uint32_t>> &found, size_t maxCount = 0);
+
+    // Proximity k-mer of residue i: the amino acids of all residues within
+    // the radius (or the closest maxLength of them), ordered by distance.
+    // The returned string is overwritten by the next call.
+    const std::string &kmer(size_t i, size_t maxLength = 0);
+
+    // Writes the proximity k-mer of every residue, one per line.
+    void writeKmers(std::ostream &out, size_t maxLength = 0);
+
+private:
+    size_t cellIndex(int cx, int cy, int cz) const {
+        return (static_cast<size_t>(cz) * dimY + cy) * dimX + cx;
+    }
+
+    DistanceFilter filterByDistance;
+
+    const ResidueCoordinates *residues = nullptr;
+    float radius = 0;
+    float cellSize = 0;
+    float minX = 0, minY = 0, minZ = 0;
+    int dimX = 0, dimY = 0, dimZ = 0;
+
+    std::vector<uint32_t> residueCells; // cell of each residue
+    std::vector<uint32_t> cellStart; // offset of each cell in cellResidues; one extra at the end
+    std::vector<uint32_t> cellResidues; // residue indices, ordered by cell
+    AlignedFloats cellX, cellY, cellZ; // coordinates, ordered by cell
+
+    // buffers, kept between structures
+    std::vector<uint32_t> cellFill;
+    std::vector<float> candidateDistances;
+    std::vector<uint32_t> candidatePositions;
+    std::vector<std::pair<float, uint32_t>> found;
+    std::string kmerBuffer;
+};
+
+#endif // NEIGHBOURGRID_H
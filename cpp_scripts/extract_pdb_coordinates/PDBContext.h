@@ -3,26 +3,80 @@
 
 #include <string>
 #include <vector>
-#include <sstream>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+
+#include "Constants.h"
+#include "Coordinates.h"
+#include "NeighbourGrid.h"
+#include "RunStats.h"
+
+class SequenceStore;
+
+enum class OutputFormat {
+    TEXT, // line-oriented protocol, read by kmers/pdb_data.py
+    BINARY, // length-prefixed records, see RecordFormat.h
+    NONE // nothing is written; the caller reads the parsed entry from the context
+};
+
+// settings from the command line
+struct ParserOptions {
+    bool printKmers = false; // print proximity k-mers instead of coordinates
+    size_t maxKmerLength = 0; // truncate k-mers to the closest residues (0 = all within radius)
+    OutputFormat format = OutputFormat::TEXT;
+    // write every valid chain as an entry of its own, instead of only the
+    // first; with allModels, also the chains of the models after the first
+    bool allChains = false;
+    bool allModels = false;
+    // UniProt sequences to match valid entries against (see UniprotMatcher.h);
+    // nullptr to skip matching
+    const SequenceStore *uniprotStore = nullptr;
+};
+
+// A valid chain, kept with ParserOptions::allChains until the whole entry is
+// parsed. Its fields are those of PDBContext with the same names; see
+// PDBContext::swapChain.
+struct ParsedChain {
+    std::string chainLabel;
+    char chainId = ' ';
+    int firstCAResidue = 0;
+    std::string parsedSequence;
+    ResidueCoordinates output;
+    std::string matchedUniprotId;
+    PDBParsingCode code = SUCCESS; // SUCCESS, or NO_UNIPROT_ID after matching
+};
 
 struct PDBContext {
+    // settings, kept across reset()
+    ParserOptions options;
+    std::string sourcePath; // file being parsed, stored in binary records
+    StageClock *clock = nullptr; // times the stages of a file (ExtractStage), with --stats
+
     // main data
     std::string pdbId;
     float resolution = -1.0f;
     std::unordered_set<std::string> uniprotIds;
+    std::string matchedUniprotId; // set by matchUniprotEntry
+    // with allChains, "_<chain id>" (and "_<model>" with allModels), written
+    // after the pdb id of each chain; see entryId()
+    std::string chainLabel;
     
     // input and output data
-    std::vector<std::string> output;
+    ResidueCoordinates output;
 
     // sequence data
-    std::stringstream parsedSequence;
-    std::unordered_map<char, std::stringstream> sequenceStreams;
+    std::string parsedSequence;
+    std::unordered_map<char, std::string> chainSequences;
 
     // residue tracking
     int prevCAResiduePosition = -1;
     int firstCAResidue = 0;
+    char chainId = ' '; // of the last CA atom
+    int model = 1; // of the last MODEL record
+
+    // valid chains, with allChains
+    std::vector<ParsedChain> chains;
 
     // condition flags
     bool hasResiduesOutOfOrder = true;
@@ -33,6 +87,38 @@ struct PDBContext {
     // error tracking
     std::vector<std::string> errorOutput;
 
+    // line buffer, neighbour search, binary record and decoded UniProt
+    // sequence, kept between files to avoid reallocating
+    std::string line;
+    NeighbourGrid grid;
+    std::string record;
+    std::string uniprotSequence;
+
+    std::string entryId() const { return pdbId + chainLabel; }
+
+    // Keeps the chain parsed so far, as the next of chains.
+    void keepChain() {
+        ParsedChain &chain = chains.emplace_back();
+        chain.chainLabel = std::string("_") + (chainId == ' ' ? '-' : chainId);
+        if (options.allModels)
+            chain.chainLabel += "_" + std::to_string(model);
+        chain.chainId = chainId;
+        chain.firstCAResidue = firstCAResidue;
+        chain.parsedSequence = parsedSequence;
+        chain.output = output;
+    }
+
+    // Exchanges the fields of chain with those of the context, so that it can
+    // be matched and written like a single entry; a second call swaps back.
+    void swapChain(ParsedChain &chain) {
+        std::swap(chainLabel, chain.chainLabel);
+        std::swap(chainId, chain.chainId);
+        std::swap(firstCAResidue, chain.firstCAResidue);
+        std::swap(parsedSequence, chain.parsedSequence);
+        std::swap(output, chain.output);
+        std::swap(matchedUniprotId, chain.matchedUniprotId);
+    }
+
     void resetPDBOutput() {
         if (!anyCAAtomsPresent && output.size()) {
             anyCAAtomsPresent = true;
@@ -43,7 +129,27 @@ struct PDBContext {
         hasExcludedAminoAcid = false;
         prevCAResiduePosition = -1;
         firstCAResidue = 0;
-        parsedSequence.str("");
+        chainId = ' ';
+        parsedSequence.clear();
+    }
+
+    // Prepares the context for parsing the next PDB entry. Buffers keep their
+    // capacity; the hash containers are replaced, so that their iteration (and
+    // therefore output) order is the same as for a freshly created context.
+    void reset() {
+        resetPDBOutput();
+
+        pdbId.clear();
+        resolution = -1.0f;
+        uniprotIds = {};
+        matchedUniprotId.clear();
+        chainLabel.clear();
+        model = 1;
+        chains.clear();
+        chainSequences = {};
+        anyCAAtomsPresent = false;
+        isNotProtein = false;
+        errorOutput.clear();
     }
 };
 
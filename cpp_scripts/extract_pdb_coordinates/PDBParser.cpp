@@ -0,0 +1,365 @@
+#include "PDBParser.h"
+
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+#include "PDBContext.h"
+#include "AtomDataParser.h"
+#include "Constants.h"
+#include "Utils.h"
+#include "PDBRecord.h"
+#include "RecordFormat.h"
+#include "UniprotMatcher.h"
+
+
+ResidueConfirmation validateAtomSequence(int &prevCAResiduePosition, const int &resSeq, int &firstCAResidue, std::vector<std::string> &errorOutput) {
+    if (prevCAResiduePosition + 1 != resSeq) {
+        if (prevCAResiduePosition == -1) { // initial value
+            prevCAResiduePosition = resSeq;
+            firstCAResidue = resSeq;
+            return RESIDUE_VALID;
+        }
+
+        if (prevCAResiduePosition == resSeq)
+            return RESIDUE_DUPLICATE;
+
+        std::stringstream errorString;
+        errorString << "missing residues; prev=" << prevCAResiduePosition << ", next=" << resSeq;
+        errorOutput.push_back(errorString.str());
+
+        prevCAResiduePosition = resSeq;
+        return RESIDUE_OUT_OF_SEQUENCE;
+    }
+    prevCAResiduePosition = resSeq;
+    return RESIDUE_VALID;
+}
+
+void processAtom(std::string_view line, PDBContext &con) {
+    AtomData data(line);
+    if (!data.isValidAtom)
+        return;
+
+    switch(validateAtomSequence(con.prevCAResiduePosition, data.resSeq, con.firstCAResidue, con.errorOutput)) {
+    case RESIDUE_VALID:
+        break; // continue
+    case RESIDUE_DUPLICATE:
+        return; // skip to next
+    case RESIDUE_OUT_OF_SEQUENCE:
+        con.hasResiduesOutOfOrder = false;
+        break;
+    }
+
+    char aminoAcid = lookupResidue(data.resName);
+    if (aminoAcid == UNKNOWN_RESIDUE) // should never happen if pdb is valid
+        throw std::runtime_error("Unexpected atom type: " + std::string(data.resName));
+
+    // Selenocysteine, Pyrrolysine, GLX, ASX, or unknown
+    if (isExcludedAminoAcid(aminoAcid))
+        con.hasExcludedAminoAcid = true;
+
+    con.chainId = data.chainId;
+
+    // construct sequence string
+    con.parsedSequence += aminoAcid;
+
+    // coordinates are only formatted when the output is printed
+    con.output.push_back(aminoAcid, data.x, data.y, data.z);
+}
+
+// Checks whether the parsed input, so far, produced a valid, sequential
+// list of residues with coordinates.
+// Returns PDBParsingCode.SUCCESS if successful, and a specific error code
+// otherwise.
+PDBParsingCode isPDBInvalid(PDBContext &con) {
+    if (con.isNotProtein)
+        return IS_NOT_PROTEIN;
+    if (con.hasExcludedAminoAcid)
+        return EXCLUDE_UNKNOWN_OR_RARE_AMINO_ACIDS;
+
+    bool isResolutionValid = con.resolution < MAX_RESOLUTION;
+    if (!isResolutionValid) // resolution too low
+        return RESOLUTION_TOO_LOW;
+
+    if (con.resolution == -1) // no valid resolution remark returned
+        return RESOLUTION_NOT_SPECIFIED;
+
+    if (!con.hasResiduesOutOfOrder) // missing non-terminal residues
+        return MISSING_NON_TERMINAL_RESIDUES;
+
+    if (con.prevCAResiduePosition == -1) { // no single CA atom found
+        if (con.anyCAAtomsPresent) // if any model had, but last one didn't
+            return MISSING_NON_TERMINAL_RESIDUES;
+        return NO_ALPHA_CARBON_ATOMS_FOUND;
+    }
+
+    if (con.uniprotIds.size() == 0)
+        return NO_UNIPROT_ID;
+
+    return SUCCESS;
+}
+
+void matchSequences(const std::unordered_map<char, std::string> &chainSequences, char chainId,
+                    const std::string &parsedSequence, std::string &matchedSequence,
+                    std::vector<std::string> &otherSequences) {
+    std::unordered_set<std::string> uniqueSequences;
+    matchedSequence = "N/A";
+    otherSequences.clear();
+
+    for (const auto & [_chainId, sequence] : chainSequences) {
+        if (sequence.size() != 0) {
+            auto sequencePosition = sequence.find(parsedSequence);
+            if (parsedSequence.size() > 0 && sequencePosition != std::string::npos) {
+                matchedSequence = sequence;
+            } else {
+                uniqueSequences.insert(sequence);
+            }
+        }
+    }
+
+    // identical chains share a sequence, so the chain's own SEQRES is
+    // preferred only among those that contain the parsed one
+    auto ownSequence = chainSequences.find(chainId);
+    if (ownSequence != chainSequences.end() && parsedSequence.size() > 0
+            && ownSequence->second.find(parsedSequence) != std::string::npos)
+        matchedSequence = ownSequence->second;
+
+    otherSequences.assign(uniqueSequences.begin(), uniqueSequences.end());
+}
+
+std::vector<std::string> processSequences(std::unordered_map<char, std::string> &chainSequences, char chainId,
+                                          std::string &parsedSequence) {
+    std::vector<std::string> outputSeq;
+
+    if (chainSequences.size() == 0)
+        return outputSeq;
+
+    std::string matchedSequence;
+    std::vector<std::string> otherSequences;
+    matchSequences(chainSequences, chainId, parsedSequence, matchedSequence, otherSequences);
+
+    // line 5: matched sequence (parsed contained within matched)
+    if (matchedSequence != "") {
+        outputSeq.push_back("matched: " + matchedSequence);
+    }
+
+    // line 6: sequence parsed from ATOM records
+    outputSeq.push_back("parsed:  " + parsedSequence);
+
+    // sequences.push_back(matchedSequence);
+
+    // line 7+: all other parsed sequences
+    for (std::string seq: otherSequences) {
+        outputSeq.push_back("other:   " + seq);
+    }
+
+    return outputSeq;
+}
+
+void printOutput(PDBContext &con, bool valid, std::ostream &out) {
+    // line 1 -- validity (0=invalid, 1=valid)
+    out << "success: " << valid << std::endl;
+
+    // line 2 -- pdb id
+    // "pdb_id:  201L" (printed in Utils.cpp)
+    out << "pdb_id:  " << con.entryId() << std::endl;
+
+    // line 3 -- resolution
+    out << "resolut: " << con.resolution << std::endl;
+
+    // line 4 -- uniprot IDs
+    std::string allUniprotIds = concatenateString(con.uniprotIds);
+    out << "uniprot: " << allUniprotIds << std::endl;
+
+    // line 5 -- matched sequence (atom record substring of reqres)
+    // line 6 -- parsed sequence (atom records)
+    // line 7-n -- other sequences (reqres sequence)
+    for (auto lineSeq: processSequences(con.chainSequences, con.chainId, con.parsedSequence))
+        out << lineSeq << std::endl;
+
+    if (!valid) // stop printing if invalid
+        return;
+
+    // line n+1: sequence number of initial residue (starts with 1)
+    out << "initres: " << con.firstCAResidue << std::endl;
+
+    if (con.options.printKmers) {
+        // line n+2: number of k-mers
+        out << "kmers:   " << con.output.size() << std::endl;
+
+        // line n+3: empty line
+        out << std::endl;
+
+        // lines n+4 to end: proximity k-mers, one per residue
+        if (con.clock) {
+            con.clock->enter(STAGE_NEIGHBOURS);
+            con.clock->count(STAGE_NEIGHBOURS, con.output.size(), 0);
+        }
+        con.grid.build(con.output, KMER_RADIUS);
+        con.grid.writeKmers(out, con.options.maxKmerLength);
+        if (con.clock)
+            con.clock->enter(STAGE_OUTPUT);
+        return;
+    }
+
+    // line n+2: empty line
+    out << std::endl;
+
+    // lines n+3 to end: coordinates in format <residue> <x> <y> <z>
+    const auto &pos = con.output;
+    for (size_t i = 0; i < pos.size(); ++i) {
+        out << pos.aminoAcids[i] << ' ' << pos.x[i] << ' ' << pos.y[i] << ' ' << pos.z[i] << std::endl;
+    }
+}
+
+// Takes in a stream of a PDB file as input, and writes the parsed entry to out.
+// The returned code is not printed; reporting it is left to the caller.
+PDBParsingCode processPDBStream(std::istream& in, std::ostream& out) {
+    PDBContext con;
+    return processPDBStream(in, out, con);
+}
+
+// The stage of lines of a record type.
+static ExtractStage stageOfRecord(uint64_t tag) {
+    if (tag == TAG_ATOM)
+        return STAGE_ATOM;
+    if (tag == TAG_SEQRES)
+        return STAGE_SEQRES;
+    if (tag == TAG_REMARK)
+        return STAGE_REMARK;
+    if (tag == TAG_DBREF || tag == TAG_DBREF1)
+        return STAGE_DBREF;
+    if (tag == TAG_TER)
+        return STAGE_TER;
+    if (tag == TAG_HEADER)
+        return STAGE_HEADER;
+    return STAGE_OTHER_RECORDS;
+}
+
+// Writes the entry in con, or the chain swapped into it, in the output format.
+static void writeEntry(PDBContext &con, PDBParsingCode code, std::ostream &out) {
+    if (con.options.format == OutputFormat::NONE)
+        return;
+
+    if (con.options.format == OutputFormat::BINARY) {
+        writeRecord(con, code, out);
+        return;
+    }
+
+    if (code != SUCCESS) {
+        printOutput(con, false, out);
+
+        for (auto error : con.errorOutput)
+            out << error << std::endl;
+        return;
+    }
+
+    printOutput(con, true, out);
+}
+
+// Matches the UniProt id of the entry in con, or of the chain swapped into it.
+static PDBParsingCode matchUniprot(PDBContext &con) {
+    if (con.clock) {
+        con.clock->enter(STAGE_UNIPROT_MATCH);
+        con.clock->count(STAGE_UNIPROT_MATCH, 1, 0);
+    }
+    auto code = matchUniprotEntry(con);
+    if (con.clock)
+        con.clock->enter(STAGE_OUTPUT);
+    return code;
+}
+
+// With allChains: matches and writes every chain kept in con.chains, one
+// entry each. Returns SUCCESS if any of them is valid.
+static PDBParsingCode writeChains(PDBContext &con, std::ostream &out) {
+    if (con.chains.empty()) { // like a single entry, without a valid chain
+        auto pdbValidity = isPDBInvalid(con);
+        writeEntry(con, pdbValidity, out);
+        return pdbValidity;
+    }
+
+    PDBParsingCode entryValidity = NO_UNIPROT_ID;
+    for (auto &chain : con.chains) {
+        con.swapChain(chain);
+        chain.code = con.options.uniprotStore ? matchUniprot(con) : SUCCESS;
+        writeEntry(con, chain.code, out);
+        con.swapChain(chain);
+
+        if (chain.code == SUCCESS)
+            entryValidity = SUCCESS;
+    }
+    return entryValidity;
+}
+
+PDBParsingCode processPDBStream(std::istream& in, std::ostream& out, PDBContext &con) {
+    con.reset();
+
+    std::string &line = con.line;
+    while (getline(in, line)) {
+        uint64_t tag = recordTag(line);
+        if (con.clock) { // the clock is only read when the record type changes
+            ExtractStage stage = stageOfRecord(tag);
+            con.clock->enter(stage);
+            con.clock->count(stage, 1, line.size() + 1);
+        }
+
+        if (tag == TAG_HEADER) {
+            auto headerType = processHeader(line, con);
+            if (headerType != PROTEIN) {
+                con.isNotProtein = true;
+                break;
+            }
+        } else if (tag == TAG_REMARK) {
+            processRemark(line, con);
+            if (con.resolution > -1 && con.resolution > MAX_RESOLUTION) // resolution bad
+                break;
+        } else if (tag == TAG_DBREF) {
+            processDBRef(line, con);
+        } else if (tag == TAG_DBREF1) {
+            processDBRef1(line, in, con);
+        } else if (tag == TAG_SEQRES) {
+            processSequence(line, con);
+        } else if (tag == TAG_ATOM) { // HETATM residues are skipped
+            processAtom(line, con);
+        } else if (tag == TAG_TER && con.options.allChains) {
+            if (isPDBInvalid(con) == SUCCESS)
+                con.keepChain();
+            con.resetPDBOutput();
+        } else if (tag == TAG_TER) { // end of one chain
+            auto pdbValidity = isPDBInvalid(con);
+            // std::cout << code_name[pdbValidity] << std::endl;
+            if (pdbValidity == SUCCESS)
+                break; // terminate parser, output PDB
+
+            // if at first you don't succeed, try, try again (parse next model)
+            con.resetPDBOutput();
+        } else if (tag == TAG_MODEL) {
+            parseInt(field(line, 10, 4), con.model);
+        } else if (tag == TAG_ENDMDL && con.options.allChains && !con.options.allModels && !con.chains.empty()) {
+            break; // the chains of the first model with any valid ones
+        } // else ignore line, until end is reached
+    }
+
+    if (con.options.allChains) {
+        // a last chain without TER
+        if (con.output.size() && isPDBInvalid(con) == SUCCESS) {
+            con.keepChain();
+            con.resetPDBOutput();
+        }
+        if (con.clock)
+            con.clock->enter(STAGE_OUTPUT);
+        return writeChains(con, out);
+    }
+
+    auto pdbValidity = isPDBInvalid(con);
+    if (pdbValidity == SUCCESS && con.options.uniprotStore)
+        pdbValidity = matchUniprot(con);
+    if (con.clock)
+        con.clock->enter(STAGE_OUTPUT);
+
+    writeEntry(con, pdbValidity, out);
+    return pdbValidity;
+}
@@ -0,0 +1,27 @@
+#ifndef PDBPARSER_H
+#define PDBPARSER_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Constants.h"
+#include "PDBContext.h"
+
+// Parses a single (decompressed) PDB entry from in and writes the
+// line-oriented result for it to out.
+PDBParsingCode processPDBStream(std::istream& in, std::ostream& out);
+
+// Same as above, but reuses the buffers of an existing context.
+PDBParsingCode processPDBStream(std::istream& in, std::ostream& out, PDBContext &con);
+
+// Finds the SEQRES sequence that contains the sequence parsed from the ATOM
+// records of chain chainId ("N/A" if there is none), preferring that of the
+// same chain, and collects the distinct other ones.
+void matchSequences(const std::unordered_map<char, std::string> &chainSequences, char chainId,
+                    const std::string &parsedSequence, std::string &matchedSequence,
+                    std::vector<std::string> &otherSequences);
+
+#endif // PDBPARSER_H
@@ -0,0 +1,114 @@
+#ifndef PDBRECORD_H
+#define PDBRECORD_H
+
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+// Helpers for reading fixed-column PDB records in place, without copying
+// fields into temporary strings.
+
+// Record names (columns 1-6) packed into an integer, so that a line can be
+// classified with a single comparison / switch.
+constexpr uint64_t recordTag(const char (&name)[7]) {
+    uint64_t tag = 0;
+    for (int i = 5; i >= 0; --i)
+        tag = (tag << 8) | static_cast<unsigned char>(name[i]);
+    return tag;
+}
+
+// Packs the record name of a line; short lines are padded with spaces.
+inline uint64_t recordTag(std::string_view line) {
+    char name[8] = {' ', ' ', ' ', ' ', ' ', ' ', 0, 0};
+    std::memcpy(name, line.data(), line.size() < 6 ? line.size() : 6);
+
+    uint64_t tag = 0;
+    for (int i = 5; i >= 0; --i)
+        tag = (tag << 8) | static_cast<unsigned char>(name[i]);
+    return tag;
+}
+
+constexpr uint64_t TAG_HEADER = recordTag("HEADER");
+constexpr uint64_t TAG_REMARK = recordTag("REMARK");
+constexpr uint64_t TAG_DBREF = recordTag("DBREF ");
+constexpr uint64_t TAG_DBREF1 = recordTag("DBREF1");
+constexpr uint64_t TAG_SEQRES = recordTag("SEQRES");
+constexpr uint64_t TAG_ATOM = recordTag("ATOM  ");
+constexpr uint64_t TAG_TER = recordTag("TER   ");
+constexpr uint64_t TAG_MODEL = recordTag("MODEL ");
+constexpr uint64_t TAG_ENDMDL = recordTag("ENDMDL");
+
+// Field of length len at position pos (0-based); clipped at the end of line.
+inline std::string_view field(std::string_view line, size_t pos, size_t len) {
+    if (pos >= line.size())
+        return std::string_view();
+    return line.substr(pos, len);
+}
+
+inline std::string_view trim(std::string_view str) {
+    size_t begin = str.find_first_not_of(' ');
+    if (begin == std::string_view::npos)
+        return std::string_view();
+    size_t end = str.find_last_not_of(' ');
+    return str.substr(begin, end - begin + 1);
+}
+
+// First whitespace separated token of str.
+inline std::string_view firstToken(std::string_view str) {
+    str = trim(str);
+    return str.substr(0, str.find(' '));
+}
+
+// Parses an integer surrounded by blanks. Returns false if there is none.
+inline bool parseInt(std::string_view str, int &value) {
+    str = trim(str);
+    if (!str.empty() && str.front() == '+')
+        str.remove_prefix(1);
+    auto result = std::from_chars(str.data(), str.data() + str.size(), value);
+    return result.ec == std::errc() && result.ptr != str.data();
+}
+
+// Parses a leading decimal number, like std::stof, but without allocating.
+// Fixed-point values (as in all coordinate and resolution columns) are
+// computed as an integer divided by a power of ten, which is exact and gives
+// the same result as strtof; anything else falls back to strtof.
+inline bool parseFloat(std::string_view str, float &value) {
+    static const float powersOfTen[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f};
+
+    str = trim(str);
+    size_t i = 0;
+    bool negative = false;
+    if (i < str.size() && (str[i] == '-' || str[i] == '+'))
+        negative = str[i++] == '-';
+
+    uint32_t mantissa = 0;
+    int digits = 0, fractionDigits = 0;
+    for (; i < str.size() && str[i] >= '0' && str[i] <= '9'; ++i, ++digits)
+        mantissa = mantissa * 10 + (str[i] - '0');
+    if (i < str.size() && str[i] == '.') {
+        for (++i; i < str.size() && str[i] >= '0' && str[i] <= '9'; ++i, ++digits, ++fractionDigits)
+            mantissa = mantissa * 10 + (str[i] - '0');
+    }
+
+    if (digits == 0)
+        return false;
+
+    bool hasExponent = i < str.size() && (str[i] == 'e' || str[i] == 'E');
+    if (digits > 7 || hasExponent) { // not exactly representable this way
+        char buffer[32];
+        size_t length = str.size() < sizeof(buffer) - 1 ? str.size() : sizeof(buffer) - 1;
+        std::memcpy(buffer, str.data(), length);
+        buffer[length] = '\0';
+        value = std::strtof(buffer, nullptr);
+        return true;
+    }
+
+    value = static_cast<float>(mantissa) / powersOfTen[fractionDigits];
+    if (negative)
+        value = -value;
+    return true;
+}
+
+#endif // PDBRECORD_H
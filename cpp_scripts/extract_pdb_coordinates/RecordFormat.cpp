@@ -0,0 +1,138 @@
+#include "RecordFormat.h"
+
+#include <cstring>
+#include <vector>
+
+#include "PDBParser.h"
+#include "Utils.h"
+
+namespace {
+
+// appends the raw bytes of value (the record format is little-endian, as are
+// all platforms this is built for)
+template <typename T>
+void append(std::string &record, T value) {
+    record.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void appendString(std::string &record, const std::string &value) {
+    append(record, static_cast<uint32_t>(value.size()));
+    record += value;
+}
+
+void pad(std::string &record) {
+    record.append((4 - record.size() % 4) % 4, '\0');
+}
+
+template <typename T>
+void appendArray(std::string &record, const T *values, size_t count) {
+    record.append(reinterpret_cast<const char *>(values), count * sizeof(T));
+}
+
+// Fills the length field at the start of record and writes it.
+void finishRecord(std::string &record, std::ostream &out) {
+    pad(record);
+    uint32_t length = static_cast<uint32_t>(record.size() - sizeof(uint32_t));
+    std::memcpy(&record[0], &length, sizeof(length));
+    out.write(record.data(), record.size());
+}
+
+void appendFixedFields(std::string &record, PDBParsingCode code, uint8_t flags, uint16_t otherCount,
+                       float resolution, int32_t firstResidue, uint32_t residueCount, uint32_t kmerBytes) {
+    append(record, uint32_t(0)); // length, filled in by finishRecord
+    append(record, static_cast<uint8_t>(code));
+    append(record, flags);
+    append(record, otherCount);
+    append(record, resolution);
+    append(record, firstResidue);
+    append(record, residueCount);
+    append(record, kmerBytes);
+}
+
+} // namespace
+
+void writeShardHeader(std::ostream &out) {
+    out.write(RECORD_SHARD_MAGIC, sizeof(RECORD_SHARD_MAGIC));
+    uint32_t fields[2] = {RECORD_FORMAT_VERSION, 0};
+    out.write(reinterpret_cast<const char *>(fields), sizeof(fields));
+}
+
+bool readShardHeader(std::istream &in) {
+    char header[RECORD_SHARD_HEADER_SIZE];
+    if (!in.read(header, sizeof(header)))
+        return false;
+
+    uint32_t version;
+    std::memcpy(&version, header + sizeof(RECORD_SHARD_MAGIC), sizeof(version));
+    return std::memcmp(header, RECORD_SHARD_MAGIC, sizeof(RECORD_SHARD_MAGIC)) == 0
+        && version == RECORD_FORMAT_VERSION;
+}
+
+void writeRecord(PDBContext &con, PDBParsingCode code, std::ostream &out) {
+    const bool valid = code == SUCCESS;
+    const bool hasKmers = valid && con.options.printKmers;
+    const auto &residues = con.output;
+    const uint32_t residueCount = valid ? residues.size() : 0;
+
+    std::string matchedSequence;
+    std::vector<std::string> otherSequences;
+    matchSequences(con.chainSequences, con.chainId, con.parsedSequence, matchedSequence, otherSequences);
+
+    // k-mers go last, so they are collected first and their size is known
+    // for the fixed fields
+    std::vector<uint32_t> kmerOffsets;
+    std::string kmers;
+    if (hasKmers) {
+        if (con.clock) {
+            con.clock->enter(STAGE_NEIGHBOURS);
+            con.clock->count(STAGE_NEIGHBOURS, residueCount, 0);
+        }
+        con.grid.build(residues, KMER_RADIUS);
+        kmerOffsets.reserve(residueCount + 1);
+        for (size_t i = 0; i < residueCount; ++i) {
+            kmerOffsets.push_back(kmers.size());
+            kmers += con.grid.kmer(i, con.options.maxKmerLength);
+        }
+        kmerOffsets.push_back(kmers.size());
+        if (con.clock)
+            con.clock->enter(STAGE_OUTPUT);
+    }
+
+    std::string &record = con.record;
+    record.clear();
+    appendFixedFields(record, code, (valid ? RECORD_VALID : 0) | (hasKmers ? RECORD_HAS_KMERS : 0),
+                      static_cast<uint16_t>(otherSequences.size()), con.resolution, con.firstCAResidue,
+                      residueCount, static_cast<uint32_t>(kmers.size()));
+
+    appendString(record, con.sourcePath);
+    appendString(record, con.entryId());
+    appendString(record, concatenateString(con.uniprotIds));
+    appendString(record, con.matchedUniprotId);
+    appendString(record, matchedSequence);
+    appendString(record, con.parsedSequence);
+    for (const auto &sequence : otherSequences)
+        appendString(record, sequence);
+    pad(record);
+
+    record.append(residues.aminoAcids, 0, residueCount);
+    pad(record);
+    appendArray(record, residues.x.data(), residueCount);
+    appendArray(record, residues.y.data(), residueCount);
+    appendArray(record, residues.z.data(), residueCount);
+
+    if (hasKmers) {
+        appendArray(record, kmerOffsets.data(), kmerOffsets.size());
+        record += kmers;
+    }
+
+    finishRecord(record, out);
+}
+
+void writeRecord(PDBParsingCode code, const std::string &path, std::ostream &out) {
+    std::string record;
+    appendFixedFields(record, code, 0, 0, -1.0f, 0, 0, 0);
+    appendString(record, path);
+    for (int i = 0; i < 5; ++i) // pdb id, uniprot ids, matched uniprot id, matched and parsed sequence
+        appendString(record, std::string());
+    finishRecord(record, out);
+}
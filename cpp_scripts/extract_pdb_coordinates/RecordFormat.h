@@ -0,0 +1,64 @@
+#ifndef RECORDFORMAT_H
+#define RECORDFORMAT_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include "Constants.h"
+#include "PDBContext.h"
+
+// Binary output of extract_pdb_coordinates (--format binary): a shard header,
+// followed by one record per PDB entry. Records are appended to a shard, so
+// a whole run can be collected into one file, and read back without parsing
+// text (see RecordReader.h and kmers/pdb_records.py).
+//
+// All integers and floats are little-endian. Every record, and every block
+// in it, starts at a multiple of 4 bytes from the start of the shard.
+//
+// shard header (16 bytes):
+//   char[8]  magic "PDBRECS\0"
+//   uint32   format version (RECORD_FORMAT_VERSION)
+//   uint32   reserved, 0
+//
+// record:
+//   uint32   length of the record after this field (multiple of 4)
+//   uint8    parsing code (PDBParsingCode)
+//   uint8    flags (RECORD_VALID, RECORD_HAS_KMERS)
+//   uint16   number of other sequences
+//   float32  resolution
+//   int32    sequence number of the first residue (initres)
+//   uint32   number of residues n (0 unless valid)
+//   uint32   k-mer bytes m (0 unless RECORD_HAS_KMERS)
+//   strings  source path, pdb id, uniprot ids (comma separated), matched
+//            uniprot id (empty unless matched against a sequence store),
+//            matched sequence, parsed sequence, other sequences; each as
+//            uint32 length and bytes, padded to 4 bytes after the last one
+//   char[n]  residues (one-letter codes), padded to 4 bytes
+//   float32  x[n], y[n], z[n]
+//   uint32   k-mer offsets[n + 1] (only with RECORD_HAS_KMERS)
+//   char[m]  k-mers, concatenated, padded to 4 bytes
+const char RECORD_SHARD_MAGIC[8] = {'P', 'D', 'B', 'R', 'E', 'C', 'S', '\0'};
+const uint32_t RECORD_FORMAT_VERSION = 2;
+const size_t RECORD_SHARD_HEADER_SIZE = 16;
+const size_t RECORD_FIXED_SIZE = 20; // fields before the strings, after the length
+
+enum RecordFlags : uint8_t {
+    RECORD_VALID = 1,
+    RECORD_HAS_KMERS = 2
+};
+
+void writeShardHeader(std::ostream &out);
+
+// Reads a shard header; false if in does not start with one of this version.
+bool readShardHeader(std::istream &in);
+
+// Writes the record of the entry parsed into con, with k-mers if
+// con.options.printKmers is set.
+void writeRecord(PDBContext &con, PDBParsingCode code, std::ostream &out);
+
+// Writes a record without parsed data, for files that could not be parsed.
+void writeRecord(PDBParsingCode code, const std::string &path, std::ostream &out);
+
+#endif // RECORDFORMAT_H
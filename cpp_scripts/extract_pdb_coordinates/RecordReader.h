@@ -0,0 +1,174 @@
+#ifndef RECORDREADER_H
+#define RECORDREADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Constants.h"
+#include "RecordFormat.h"
+
+// One record of a shard, viewed in place; valid while the shard is open.
+struct RecordView {
+    PDBParsingCode code = SUCCESS;
+    uint8_t flags = 0;
+    float resolution = -1.0f;
+    int32_t firstResidue = 0;
+    uint32_t residueCount = 0;
+
+    std::string_view path, pdbId, uniprotIds, matchedUniprotId, matchedSequence, parsedSequence;
+    std::vector<std::string_view> otherSequences;
+
+    std::string_view residues;
+    const float *x = nullptr, *y = nullptr, *z = nullptr;
+
+    const uint32_t *kmerOffsets = nullptr;
+    const char *kmerData = nullptr;
+
+    bool valid() const { return flags & RECORD_VALID; }
+    bool hasKmers() const { return flags & RECORD_HAS_KMERS; }
+
+    std::string_view kmer(size_t i) const {
+        return std::string_view(kmerData + kmerOffsets[i], kmerOffsets[i + 1] - kmerOffsets[i]);
+    }
+};
+
+// Read-only memory mapping of a record shard (see RecordFormat.h), read
+// front to back.
+class RecordShard {
+public:
+    RecordShard() = default;
+    RecordShard(const RecordShard &) = delete;
+    RecordShard &operator=(const RecordShard &) = delete;
+    ~RecordShard() { close(); }
+
+    // Maps path; false if it cannot be read or is not a shard of this version.
+    bool open(const std::string &path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= RECORD_SHARD_HEADER_SIZE) {
+            size = info.st_size;
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            data = mapped == MAP_FAILED ? nullptr : static_cast<const char *>(mapped);
+        }
+        ::close(fd);
+
+        if (!data || std::memcmp(data, RECORD_SHARD_MAGIC, sizeof(RECORD_SHARD_MAGIC)) != 0
+            || load<uint32_t>(data + sizeof(RECORD_SHARD_MAGIC)) != RECORD_FORMAT_VERSION) {
+            close();
+            return false;
+        }
+
+        madvise(const_cast<char *>(data), size, MADV_SEQUENTIAL);
+        position = RECORD_SHARD_HEADER_SIZE;
+        return true;
+    }
+
+    void close() {
+        if (data)
+            munmap(const_cast<char *>(data), size);
+        data = nullptr;
+        size = position = 0;
+    }
+
+    // Reads the next record into record; false at the end of the shard, or
+    // if the rest of it is truncated.
+    bool next(RecordView &record) {
+        if (!data || position + sizeof(uint32_t) > size)
+            return false;
+        size_t length = load<uint32_t>(data + position);
+        const char *start = data + position + sizeof(uint32_t);
+        const char *end = start + length;
+        if (length < RECORD_FIXED_SIZE || end > data + size)
+            return false;
+        position += sizeof(uint32_t) + length;
+
+        const char *p = start;
+        record.code = static_cast<PDBParsingCode>(load<uint8_t>(p));
+        record.flags = load<uint8_t>(p + 1);
+        uint16_t otherCount = load<uint16_t>(p + 2);
+        record.resolution = load<float>(p + 4);
+        record.firstResidue = load<int32_t>(p + 8);
+        record.residueCount = load<uint32_t>(p + 12);
+        uint32_t kmerBytes = load<uint32_t>(p + 16);
+        p += RECORD_FIXED_SIZE;
+
+        std::string_view *fields[] = {&record.path, &record.pdbId, &record.uniprotIds, &record.matchedUniprotId,
+                                      &record.matchedSequence, &record.parsedSequence};
+        for (auto *field : fields) {
+            if (!readString(p, end, *field))
+                return false;
+        }
+        record.otherSequences.resize(otherCount);
+        for (auto &sequence : record.otherSequences) {
+            if (!readString(p, end, sequence))
+                return false;
+        }
+        p = aligned(p);
+        if (p > end)
+            return false;
+
+        const size_t n = record.residueCount;
+        const size_t blockBytes = (n + 3) / 4 * 4 + 3 * n * sizeof(float)
+            + (record.hasKmers() ? (n + 1) * sizeof(uint32_t) + kmerBytes : 0);
+        if (blockBytes > static_cast<size_t>(end - p))
+            return false;
+
+        record.residues = std::string_view(p, n);
+        p = aligned(p + n);
+        record.x = reinterpret_cast<const float *>(p);
+        record.y = record.x + n;
+        record.z = record.y + n;
+        p += 3 * n * sizeof(float);
+
+        record.kmerOffsets = nullptr;
+        record.kmerData = nullptr;
+        if (record.hasKmers()) {
+            record.kmerOffsets = reinterpret_cast<const uint32_t *>(p);
+            record.kmerData = p + (n + 1) * sizeof(uint32_t);
+        }
+        return true;
+    }
+
+private:
+    template <typename T>
+    static T load(const char *p) {
+        T value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static bool readString(const char *&p, const char *end, std::string_view &value) {
+        if (end - p < static_cast<ptrdiff_t>(sizeof(uint32_t)))
+            return false;
+        uint32_t length = load<uint32_t>(p);
+        if (length > static_cast<size_t>(end - p) - sizeof(uint32_t))
+            return false;
+        value = std::string_view(p + sizeof(uint32_t), length);
+        p += sizeof(uint32_t) + length;
+        return true;
+    }
+
+    // next multiple of 4 bytes from the start of the shard
+    const char *aligned(const char *p) const {
+        return data + (p - data + 3) / 4 * 4;
+    }
+
+    const char *data = nullptr;
+    size_t size = 0;
+    size_t position = 0;
+};
+
+#endif // RECORDREADER_H
@@ -0,0 +1,276 @@
+#ifndef RUNSTATS_H
+#define RUNSTATS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+
+// Statistics of a run, written as JSON by --stats FILE: cumulative time,
+// items and bytes per stage, a histogram of the outcomes of the items a run
+// processes (e.g. the parsing codes of PDB files), a latency histogram and
+// the slowest of those items, and peak RSS. Shared by extract_pdb_coordinates
+// and post_process_kmers.
+//
+// Every thread times its work with its own StageClock and adds it to the
+// RunStats once per item, so that the shared totals are only locked once per
+// item, and can be written at any time.
+
+struct StageTotals {
+    uint64_t nanoseconds = 0;
+    uint64_t items = 0; // e.g. lines of a record type
+    uint64_t bytes = 0;
+};
+
+// Attributes the time of one thread to one stage at a time. Only a change of
+// stage reads the clock.
+class StageClock {
+public:
+    static constexpr size_t IDLE = SIZE_MAX;
+
+    explicit StageClock(size_t stageCount = 0) : totals(stageCount) {}
+
+    // Ends the current stage and starts timing stage (IDLE: none); returns
+    // the stage that was current.
+    size_t switchTo(size_t stage) {
+        auto now = std::chrono::steady_clock::now();
+        if (current != IDLE)
+            totals[current].nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(now - since).count();
+        size_t previous = current;
+        current = stage;
+        since = now;
+        return previous;
+    }
+
+    void enter(size_t stage) {
+        if (stage != current)
+            switchTo(stage);
+    }
+
+    void count(size_t stage, uint64_t items, uint64_t bytes) {
+        totals[stage].items += items;
+        totals[stage].bytes += bytes;
+    }
+
+    void stop() { switchTo(IDLE); }
+
+    // Stops, and clears the totals.
+    void reset() {
+        current = IDLE;
+        for (auto &stage : totals)
+            stage = StageTotals();
+    }
+
+    const std::vector<StageTotals> &stageTotals() const { return totals; }
+
+private:
+    std::vector<StageTotals> totals;
+    size_t current = IDLE;
+    std::chrono::steady_clock::time_point since;
+};
+
+// Peak resident set size of this process, in bytes.
+inline uint64_t peakRssBytes() {
+    struct rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss); // bytes
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+}
+
+class RunStats {
+public:
+    // latency buckets: bucket b counts items that took less than 2^b
+    // microseconds (and at least 2^(b-1)); the last one counts all others
+    static constexpr size_t LATENCY_BUCKETS = 40;
+    static constexpr size_t SLOWEST_ITEMS = 10;
+
+    RunStats(std::string program, std::vector<std::string> stageNames, std::vector<std::string> outcomeNames)
+        : program(std::move(program)), stageNames(std::move(stageNames)), outcomeNames(std::move(outcomeNames)),
+          stages(this->stageNames.size()), outcomes(this->outcomeNames.size()), latencies(LATENCY_BUCKETS),
+          start(std::chrono::steady_clock::now()) {}
+
+    size_t stageCount() const { return stageNames.size(); }
+
+    // Adds the stage totals of clock.
+    void addStages(const StageClock &clock) {
+        std::lock_guard<std::mutex> lock(mutex);
+        addStagesLocked(clock);
+    }
+
+    // Adds the stage totals of clock, and one item with outcome that took
+    // seconds; name identifies it among the slowest items.
+    void addItem(const StageClock &clock, size_t outcome, double seconds, const std::string &name) {
+        uint64_t microseconds = static_cast<uint64_t>(seconds * 1e6);
+        size_t bucket = 0;
+        while (bucket + 1 < LATENCY_BUCKETS && microseconds >= (uint64_t(1) << bucket))
+            ++bucket;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        addStagesLocked(clock);
+        outcomes[outcome]++;
+        latencies[bucket]++;
+        itemCount++;
+
+        if (slowest.size() < SLOWEST_ITEMS || seconds > slowest.back().seconds) {
+            if (slowest.size() == SLOWEST_ITEMS)
+                slowest.pop_back();
+            auto position = slowest.begin();
+            while (position != slowest.end() && position->seconds >= seconds)
+                ++position;
+            slowest.insert(position, {name, outcome, seconds});
+        }
+    }
+
+    // Writes a snapshot to path (through <path>.tmp, so that a reader never
+    // sees a partial file); final marks the one written at the end of the
+    // run. Returns false if it cannot be written.
+    bool writeJson(const std::string &path, bool final) const {
+        std::ofstream out(path + ".tmp");
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            out << "{\n  \"program\": " << quote(program)
+                << ",\n  \"final\": " << (final ? "true" : "false")
+                << ",\n  \"elapsed_seconds\": " << elapsed
+                << ",\n  \"peak_rss_bytes\": " << peakRssBytes()
+                << ",\n  \"items\": " << itemCount
+                << ",\n  \"stages\": {";
+            for (size_t i = 0; i < stages.size(); ++i) {
+                out << (i ? "," : "") << "\n    " << quote(stageNames[i]) << ": {\"seconds\": "
+                    << stages[i].nanoseconds / 1e9 << ", \"items\": " << stages[i].items
+                    << ", \"bytes\": " << stages[i].bytes << '}';
+            }
+            out << "\n  },\n  \"outcomes\": {";
+            for (size_t i = 0; i < outcomes.size(); ++i)
+                out << (i ? ", " : "") << quote(outcomeNames[i]) << ": " << outcomes[i];
+            out << "},\n  \"latency_histogram\": [";
+            size_t lastBucket = 0;
+            for (size_t b = 0; b < latencies.size(); ++b) {
+                if (latencies[b])
+                    lastBucket = b + 1;
+            }
+            for (size_t b = 0; b < lastBucket; ++b) {
+                out << (b ? ", " : "") << "{\"below_microseconds\": ";
+                if (b + 1 < LATENCY_BUCKETS)
+                    out << (uint64_t(1) << b);
+                else
+                    out << "null";
+                out << ", \"count\": " << latencies[b] << '}';
+            }
+            out << "],\n  \"slowest\": [";
+            for (size_t i = 0; i < slowest.size(); ++i) {
+                out << (i ? "," : "") << "\n    {\"name\": " << quote(slowest[i].name) << ", \"outcome\": "
+                    << quote(outcomeNames[slowest[i].outcome]) << ", \"seconds\": " << slowest[i].seconds << '}';
+            }
+            out << "\n  ]\n}\n";
+        }
+        out.close();
+        return out && std::rename((path + ".tmp").c_str(), path.c_str()) == 0;
+    }
+
+private:
+    struct SlowItem {
+        std::string name;
+        size_t outcome;
+        double seconds;
+    };
+
+    void addStagesLocked(const StageClock &clock) {
+        const auto &totals = clock.stageTotals();
+        for (size_t i = 0; i < totals.size() && i < stages.size(); ++i) {
+            stages[i].nanoseconds += totals[i].nanoseconds;
+            stages[i].items += totals[i].items;
+            stages[i].bytes += totals[i].bytes;
+        }
+    }
+
+    static std::string quote(const std::string &text) {
+        std::string quoted = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                quoted += '\\';
+                quoted += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                quoted += escaped;
+            } else {
+                quoted += c;
+            }
+        }
+        return quoted + '"';
+    }
+
+    const std::string program;
+    const std::vector<std::string> stageNames;
+    const std::vector<std::string> outcomeNames;
+
+    mutable std::mutex mutex;
+    std::vector<StageTotals> stages;
+    std::vector<uint64_t> outcomes;
+    std::vector<uint64_t> latencies;
+    std::vector<SlowItem> slowest; // slowest first
+    uint64_t itemCount = 0;
+    const std::chrono::steady_clock::time_point start;
+};
+
+// Writes stats to path every intervalSeconds (0: never) on a thread of its
+// own, and a last time, marked final, in finish.
+class PeriodicStatsWriter {
+public:
+    PeriodicStatsWriter(const RunStats &stats, std::string path, double intervalSeconds)
+        : stats(stats), path(std::move(path)) {
+        if (intervalSeconds > 0) {
+            writer = std::thread([this, intervalSeconds] {
+                std::unique_lock<std::mutex> lock(mutex);
+                auto interval = std::chrono::duration<double>(intervalSeconds);
+                while (!stopped) {
+                    if (cv.wait_for(lock, interval, [this] { return stopped; }))
+                        break;
+                    this->stats.writeJson(this->path, false);
+                }
+            });
+        }
+    }
+
+    ~PeriodicStatsWriter() { finish(); }
+
+    PeriodicStatsWriter(const PeriodicStatsWriter &) = delete;
+    PeriodicStatsWriter &operator=(const PeriodicStatsWriter &) = delete;
+
+    // Stops the periodic writes and writes the final stats; false if they
+    // cannot be written. Only the first call writes.
+    bool finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopped)
+                return true;
+            stopped = true;
+        }
+        cv.notify_all();
+        if (writer.joinable())
+            writer.join();
+        return stats.writeJson(path, true);
+    }
+
+private:
+    const RunStats &stats;
+    const std::string path;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopped = false;
+    std::thread writer;
+};
+
+#endif // RUNSTATS_H
@@ -0,0 +1,60 @@
+#include "UniprotMatcher.h"
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "../fasta_to_sqlite/SequenceStore.h"
+
+namespace {
+
+// compares in place, without decoding the rest of the stored sequence
+bool matchesAt(const StoredSequence &sequence, size_t start, const std::string &parsed) {
+    if (start + parsed.size() > sequence.length)
+        return false;
+    for (size_t i = 0; i < parsed.size(); ++i) {
+        if (sequence[start + i] != parsed[i])
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+PDBParsingCode matchUniprotEntry(PDBContext &con) {
+    con.matchedUniprotId.clear();
+    const SequenceStore &store = *con.options.uniprotStore;
+    const std::string &parsed = con.parsedSequence;
+
+    // same order as the uniprot ids in the output (concatenateString)
+    std::vector<std::pair<const std::string *, StoredSequence>> candidates;
+    for (const auto &id : con.uniprotIds) {
+        StoredSequence sequence;
+        if (store.find(id, sequence))
+            candidates.emplace_back(&id, sequence);
+    }
+
+    if (con.firstCAResidue > 0) {
+        for (const auto &[id, sequence] : candidates) {
+            if (matchesAt(sequence, con.firstCAResidue - 1, parsed)) {
+                con.matchedUniprotId = *id;
+                return SUCCESS;
+            }
+        }
+    }
+
+    // string_view::find skips to candidate positions with memchr on the
+    // first residue, then compares
+    std::string &decoded = con.uniprotSequence;
+    for (const auto &[id, sequence] : candidates) {
+        decoded.resize(sequence.length);
+        for (size_t i = 0; i < sequence.length; ++i)
+            decoded[i] = sequence[i];
+        if (std::string_view(decoded).find(parsed) != std::string_view::npos) {
+            con.matchedUniprotId = *id;
+            return SUCCESS;
+        }
+    }
+    return NO_UNIPROT_ID;
+}
@@ -0,0 +1,18 @@
+#ifndef UNIPROTMATCHER_H
+#define UNIPROTMATCHER_H
+
+#include "Constants.h"
+#include "PDBContext.h"
+
+// Associates the parsed entry in con with one of its UniProt ids, looked up
+// in con.options.uniprotStore, and stores it in con.matchedUniprotId.
+//
+// An id matches if its UniProt sequence has the parsed sequence at the
+// position of the first residue (initres); if no id does, the first whose
+// sequence contains the parsed sequence anywhere. Among several matches,
+// the first id in the order they are written out wins.
+//
+// Returns SUCCESS, or NO_UNIPROT_ID if no id matches.
+PDBParsingCode matchUniprotEntry(PDBContext &con);
+
+#endif // UNIPROTMATCHER_H
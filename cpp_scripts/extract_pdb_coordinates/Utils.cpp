@@ -1,11 +1,13 @@
 #include "Utils.h"
 #include <sstream>
+#include <string_view>
 #include <iterator>
 #include <unordered_set>
 #include <iostream>
 
 #include "Constants.h"
 #include "PDBContext.h"
+#include "PDBRecord.h"
 
 std::string concatenateString(const std::vector<std::string>& strings) {
     const char delim = ',';
@@ -38,37 +40,36 @@ std::string concatenateString(const std::unordered_set<std::string>& strings) {
 }
 
 // Extracts the resolution from remark 2
-float extractResolution(const std::string &line) {
-    std::string res_section = line.substr(23, 7);
+float extractResolution(std::string_view line) {
+    std::string_view res_section = field(line, 23, 7);
     // skip empty remark line
-    if (res_section == "       ") {
+    if (trim(res_section).empty()) {
         return -1;
     }
-    try {
-        return std::stof(line.substr(23, 7));
-    } catch(std::invalid_argument) {
+
+    float resolution;
+    if (!parseFloat(res_section, resolution))
         return -2; // RESOLUTION. NOT APPLICABLE. (e.g. pdb 134D)
-    }
 
-    return std::stof(line.substr(23, 7));
+    return resolution;
 }
 
 /////////////////////
 /// PROCESS ENTRY ///
 /////////////////////
 
-PDBType processHeader(const std::string &line, PDBContext &con) {
-    std::string cls = line.substr(10, 40); // 11-50
-    std::string pdbId = line.substr(62, 4); // 63-66
+PDBType processHeader(std::string_view line, PDBContext &con) {
+    std::string_view cls = field(line, 10, 40); // 11-50
+    std::string_view pdbId = field(line, 62, 4); // 63-66
 
     con.pdbId = pdbId;
  
-    if (cls.find("DNA") != std::string::npos) {
-        if (cls.find("DNA BINDING PROTEIN") == std::string::npos)
+    if (cls.find("DNA") != std::string_view::npos) {
+        if (cls.find("DNA BINDING PROTEIN") == std::string_view::npos)
             return DNA;
     }
-    if (cls.find("RNA") != std::string::npos) {
-        if (cls.find("RNA BINDING PROTEIN") == std::string::npos)
+    if (cls.find("RNA") != std::string_view::npos) {
+        if (cls.find("RNA BINDING PROTEIN") == std::string_view::npos)
             return RNA;
     }
 
@@ -76,59 +77,64 @@ PDBType processHeader(const std::string &line, PDBContext &con) {
 }
 
 // Remark row
-void processRemark(const std::string &line, PDBContext &con) {
-    int remark_no = std::stoi(line.substr(7, 3));
+void processRemark(std::string_view line, PDBContext &con) {
+    int remark_no;
+    if (!parseInt(field(line, 7, 3), remark_no))
+        return;
+
     switch (remark_no) {
         case 2:
-            int extractedRes = extractResolution(line);
+            float extractedRes = extractResolution(line);
             if (extractedRes != -1) {
-                con.resolution = extractResolution(line);
+                con.resolution = extractedRes;
             }
             break;
     }
 }
 
 // DBRef row
-void processDBRef(const std::string &line, PDBContext &con) {
-    std::string db = line.substr(26, 6); // 27 - 32
+void processDBRef(std::string_view line, PDBContext &con) {
+    std::string_view db = field(line, 26, 6); // 27 - 32
     if (db != "UNP   ") // only match uniprot
         return;
 
-    std::string uniprotId = line.substr(33, 8); // 34 - 41
-    std::stringstream parser(uniprotId);
-    parser >> uniprotId;
-    con.uniprotIds.insert(uniprotId);
+    std::string_view uniprotId = firstToken(field(line, 33, 8)); // 34 - 41
+    con.uniprotIds.emplace(uniprotId);
 }
 
-void processDBRef1(const std::string &line, PDBContext &con) {
+void processDBRef1(std::string_view line, std::istream &in, PDBContext &con) {
     // process 1 for uniprot
-    std::string db = line.substr(26, 6); // 27 - 32
+    std::string_view db = field(line, 26, 6); // 27 - 32
     if (db != "UNP   ") // only match uniprot
         return;
 
     // process 2 for id
     std::string nextLine;
-    getline(std::cin, nextLine);
+    getline(in, nextLine);
 
-    std::string uniprotId = nextLine.substr(18, 22); // 19 - 40
-    std::stringstream parser(uniprotId);
-    parser >> uniprotId;
-    con.uniprotIds.insert(uniprotId);
+    std::string_view uniprotId = firstToken(field(nextLine, 18, 22)); // 19 - 40
+    con.uniprotIds.emplace(uniprotId);
 }
 
 // SEQRES row
-void processSequence(const std::string &line, PDBContext &con) {
+void processSequence(std::string_view line, PDBContext &con) {
     char chainId = line[11];
-    std::string aa;
-    std::string aaLine = line.substr(19, 51);
-    std::stringstream aaStream(aaLine);
-    while (aaStream >> aa) {
-        try {
-            con.sequenceStreams[chainId] << aminoAcidLookup.at(aa);
-        } catch (std::out_of_range) {
+    std::string_view aaLine = field(line, 19, 51);
+    if (trim(aaLine).empty())
+        return;
+
+    std::string &sequence = con.chainSequences[chainId];
+
+    while (!(aaLine = trim(aaLine)).empty()) {
+        std::string_view aa = aaLine.substr(0, aaLine.find(' '));
+        aaLine.remove_prefix(aa.size());
+
+        char aminoAcid = lookupResidue(aa);
+        if (aminoAcid == UNKNOWN_RESIDUE) {
             // replace non-standard AA with dot (.)
-            con.sequenceStreams[chainId] << '.';
+            sequence += '.';
             return;
         }
+        sequence += aminoAcid;
     }
-}
\ No newline at end of file
+}
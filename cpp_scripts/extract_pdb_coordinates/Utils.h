@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
+#include <istream>
 #include <unordered_set>
 
 #include "Constants.h"
@@ -11,10 +13,10 @@
 std::string concatenateString(const std::vector<std::string>& strings);
 std::string concatenateString(const std::unordered_set<std::string>& strings);
 
-PDBType processHeader(const std::string &line, PDBContext &con);
-void processRemark(const std::string &line, PDBContext &con);
-void processDBRef(const std::string &line, PDBContext &con);
-void processDBRef1(const std::string &line, PDBContext &con);
-void processSequence(const std::string &line, PDBContext &con);
+PDBType processHeader(std::string_view line, PDBContext &con);
+void processRemark(std::string_view line, PDBContext &con);
+void processDBRef(std::string_view line, PDBContext &con);
+void processDBRef1(std::string_view line, std::istream &in, PDBContext &con);
+void processSequence(std::string_view line, PDBContext &con);
 
 #endif // UTILS_H
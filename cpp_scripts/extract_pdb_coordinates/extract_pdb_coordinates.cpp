@@ -1,278 +1,189 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
-#include <unordered_map>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
-#include <unordered_set>
 
-#include "PDBContext.h"
-#include "AtomDataParser.h"
+#include "BatchProcessor.h"
 #include "Constants.h"
-#include "Utils.h"
-
-
-ResidueConfirmation validateAtomSequence(int &prevCAResiduePosition, const int &resSeq, int &firstCAResidue, std::vector<std::string> &errorOutput) {
-    if (prevCAResiduePosition + 1 != resSeq) {
-        if (prevCAResiduePosition == -1) { // initial value
-            prevCAResiduePosition = resSeq;
-            firstCAResidue = resSeq;
-            return RESIDUE_VALID;
-        }
-
-        if (prevCAResiduePosition == resSeq)
-            return RESIDUE_DUPLICATE;
-
-        std::stringstream errorString;
-        errorString << "missing residues; prev=" << prevCAResiduePosition << ", next=" << resSeq;
-        errorOutput.push_back(errorString.str());
-
-        prevCAResiduePosition = resSeq;
-        return RESIDUE_OUT_OF_SEQUENCE;
-    }
-    prevCAResiduePosition = resSeq;
-    return RESIDUE_VALID;
-}
-
-void processAtom(const std::string &line, PDBContext &con) {
-    AtomData data(line, 0);
-    if (!data.isValidAtom)
-        return;
-
-    switch(validateAtomSequence(con.prevCAResiduePosition, data.resSeq, con.firstCAResidue, con.errorOutput)) {
-    case RESIDUE_VALID:
-        break; // continue
-    case RESIDUE_DUPLICATE:
-        return; // skip to next
-    case RESIDUE_OUT_OF_SEQUENCE:
-        con.hasResiduesOutOfOrder = false;
-        break;
-    }
-
-    char aminoAcid;
-    try {
-        aminoAcid = aminoAcidLookup.at(data.resName);
-    } catch (std::out_of_range) { // should never throw if pdb is valid
-        throw std::runtime_error("Unexpected atom type: " + data.resName);
-    }
-
-    // Selenocysteine, Pyrrolysine, GLX, ASX, or unknown
-    if (invalidAminoAcids.find(aminoAcid) != invalidAminoAcids.end())
-        con.hasExcludedAminoAcid = true;
-
-    // construct output string
-    std::stringstream ss;
-    ss << aminoAcid << ' ' << data.x << ' '  << data.y << ' ' << data.z;
-    // std::cout << aminoAcid << ' ' << data.x << ' '  << data.y << ' ' << data.z << std::endl;
-
-    // construct sequence string
-    con.parsedSequence << aminoAcid;
-
-    con.output.push_back(ss.str());
-}
-
-// Checks whether the parsed input, so far, produced a valid, sequential
-// list of residues with coordinates.
-// Returns PDBParsingCode.SUCCESS if successful, and a specific error code
-// otherwise.
-PDBParsingCode isPDBInvalid(PDBContext &con) {
-    if (con.isNotProtein)
-        return IS_NOT_PROTEIN;
-    if (con.hasExcludedAminoAcid)
-        return EXCLUDE_UNKNOWN_OR_RARE_AMINO_ACIDS;
-
-    bool isResolutionValid = con.resolution < MAX_RESOLUTION;
-    if (!isResolutionValid) // resolution too low
-        return RESOLUTION_TOO_LOW;
-
-    if (con.resolution == -1) // no valid resolution remark returned
-        return RESOLUTION_NOT_SPECIFIED;
-
-    if (!con.hasResiduesOutOfOrder) // missing non-terminal residues
-        return MISSING_NON_TERMINAL_RESIDUES;
-
-    if (con.prevCAResiduePosition == -1) { // no single CA atom found
-        if (con.anyCAAtomsPresent) // if any model had, but last one didn't
-            return MISSING_NON_TERMINAL_RESIDUES;
-        return NO_ALPHA_CARBON_ATOMS_FOUND;
-    }
-
-    if (con.uniprotIds.size() == 0)
-        return NO_UNIPROT_ID;
-
-    return SUCCESS;
+#include "PDBContext.h"
+#include "PDBParser.h"
+#include "RecordFormat.h"
+#include "RunStats.h"
+#include "../fasta_to_sqlite/SequenceStore.h"
+
+void printUsage(const char *program) {
+    std::cerr << "Usage: " << program << " [--kmers] [--format text|binary] [--output FILE] [--uniprot-store FILE]\n"
+              << "       [--process-file-stream | --process-files [-j N] [PATH ...]]\n"
+              << "Options:\n"
+              << "  --process-file-stream    Parse one decompressed PDB from stdin (default)\n"
+              << "  --process-files [PATH]   Parse .ent.gz files; directories are searched recursively.\n"
+              << "                           Without PATH, file paths are read from stdin, one per line.\n"
+              << "  -j <threads>             Number of worker threads for --process-files\n"
+              << "                           (default=1, 0=all cores)\n"
+              << "  --kmers                  Print proximity k-mers (residues within 15 angstrom,\n"
+              << "                           by distance) instead of coordinates\n"
+              << "  --kmer-length <length>   Only keep the closest <length> residues of each k-mer\n"
+              << "  --all-chains             Write every valid chain of an entry, instead of the\n"
+              << "                           first, as an entry of its own with pdb id\n"
+              << "                           <id>_<chain> (chains of the first model with any)\n"
+              << "  --all-models             Like --all-chains, for the chains of every model,\n"
+              << "                           with pdb id <id>_<chain>_<model>\n"
+              << "  --format <format>        text (default): line-oriented output;\n"
+              << "                           binary: length-prefixed records, see RecordFormat.h\n"
+              << "  --output <file>          Append the output to <file> instead of stdout; binary\n"
+              << "                           output is appended to the record shard in <file>\n"
+              << "  --uniprot-store <file>   Match valid entries against the UniProt sequences in\n"
+              << "                           <file> (fasta_to_sqlite --store); entries without a\n"
+              << "                           match are NO_UNIPROT_ID. Binary records carry the\n"
+              << "                           matched id.\n"
+              << "  --stats <file>           Write statistics of the run to <file> as JSON: time,\n"
+              << "                           lines and bytes per stage and record type, parsing\n"
+              << "                           codes, per-file latency histogram and slowest files,\n"
+              << "                           and peak RSS (see RunStats.h)\n"
+              << "  --stats-interval <s>     Also write them every <s> seconds during the run\n"
+              << "                           (default=60, 0=only at the end)\n"
+              << "  -h, --help               Display this help message and exit\n";
 }
 
-std::vector<std::string> processSequences(std::unordered_map<char, std::stringstream> &sequenceStreams, std::stringstream &parsedSequence) {
-    std::unordered_set<std::string> uniqueSequences;
-    std::vector<std::string> outputSeq;
-    std::string matchedSequence = "N/A";
-
-    if (sequenceStreams.size() == 0)
-        return outputSeq;
+int main(int argc, char const *argv[]) {
+    std::ios_base::sync_with_stdio(false);
+    std::cin.tie(NULL);
 
-    for (const auto & [_chainId, stream] : sequenceStreams) {
-        auto sequence = stream.str();
-        if (sequence.size() != 0) {
-            auto sequencePosition = sequence.find(parsedSequence.str());
-            if (parsedSequence.str().size() > 0 && sequencePosition != std::string::npos) {
-                matchedSequence = sequence;
-            } else {
-                uniqueSequences.insert(sequence);
+    std::string mode = "--process-file-stream";
+    unsigned int threadCount = 1;
+    ParserOptions options;
+    std::vector<std::string> paths;
+    std::string outputPath;
+    std::string uniprotStorePath;
+    std::string statsPath;
+    double statsInterval = 60;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg == "--process-file-stream" || arg == "--process-files") {
+            mode = arg;
+        } else if (arg == "-j" && i + 1 < argc) {
+            threadCount = std::stoi(argv[++i]);
+        } else if (arg == "--kmers") {
+            options.printKmers = true;
+        } else if (arg == "--all-chains") {
+            options.allChains = true;
+        } else if (arg == "--all-models") {
+            options.allChains = true;
+            options.allModels = true;
+        } else if (arg == "--kmer-length" && i + 1 < argc) {
+            options.maxKmerLength = std::stoul(argv[++i]);
+        } else if (arg == "--format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            if (format != "text" && format != "binary") {
+                std::cerr << "Invalid format: " << format << std::endl;
+                return 1;
             }
+            options.format = format == "binary" ? OutputFormat::BINARY : OutputFormat::TEXT;
+        } else if (arg == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (arg == "--uniprot-store" && i + 1 < argc) {
+            uniprotStorePath = argv[++i];
+        } else if (arg == "--stats" && i + 1 < argc) {
+            statsPath = argv[++i];
+        } else if (arg == "--stats-interval" && i + 1 < argc) {
+            statsInterval = std::stod(argv[++i]);
+        } else if (mode == "--process-files") {
+            paths.push_back(arg);
+        } else {
+            std::cerr << "Invalid argument: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
         }
     }
 
-    // line 5: matched sequence (parsed contained within matched)
-    if (matchedSequence != "") {
-        outputSeq.push_back("matched: " + matchedSequence);
-    }
-
-    // line 6: sequence parsed from ATOM records
-    outputSeq.push_back("parsed:  " + parsedSequence.str());
-
-    // sequences.push_back(matchedSequence);
-
-    // line 7+: all other parsed sequences
-    for (std::string seq: uniqueSequences) {
-        outputSeq.push_back("other:   " + seq);
-    }
-
-    return outputSeq;
-}
-
-void printOutput(PDBContext &con, bool valid) {
-    // line 1 -- validity (0=invalid, 1=valid)
-    std::cout << "success: " << valid << std:: endl;
-
-    // line 2 -- pdb id
-    // "pdb_id:  201L" (printed in Utils.cpp)
-    std::cout << "pdb_id:  " << con.pdbId << std::endl;
-
-    // line 3 -- resolution
-    std::cout << "resolut: " << con.resolution << std::endl;
-
-    // line 4 -- uniprot IDs
-    std::string allUniprotIds = concatenateString(con.uniprotIds);
-    std::cout << "uniprot: " << allUniprotIds << std::endl;
-
-    // line 5 -- matched sequence (atom record substring of reqres)
-    // line 6 -- parsed sequence (atom records)
-    // line 7-n -- other sequences (reqres sequence)
-    for (auto lineSeq: processSequences(con.sequenceStreams, con.parsedSequence))
-        std::cout << lineSeq << std::endl;
-
-    if (!valid) // stop printing if invalid
-        return;
-
-    // line n+1: sequence number of initial residue (starts with 1)
-    std::cout << "initres: " << con.firstCAResidue << std::endl;
-
-    // line n+2: empty line
-    std::cout << std::endl;
-
-    // lines n+3 to end: coordinates in format <residue> <x> <y> <z>
-    for (std::string pos : con.output) {
-        std::cout << pos << std::endl;
+    SequenceStore uniprotStore;
+    if (!uniprotStorePath.empty()) {
+        std::string error;
+        if (!uniprotStore.open(uniprotStorePath, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        options.uniprotStore = &uniprotStore;
     }
-}
 
-// Takes in a stream of a PDB file as input.
-PDBParsingCode processPDBStream(std::istream& in) {
-    PDBContext con;
-    
-    std::string line;
-    while (getline(in, line)) {
-        std::string param = line.substr(0, 6);
-
-        if (param == "HEADER") {
-            auto headerType = processHeader(line, con);
-            if (headerType != PROTEIN) {
-                con.isNotProtein = true;
-                break;
+    std::ofstream outputFile;
+    if (!outputPath.empty()) {
+        bool append = std::filesystem::exists(outputPath) && std::filesystem::file_size(outputPath) > 0;
+        if (append && options.format == OutputFormat::BINARY) {
+            std::ifstream existing(outputPath, std::ios::binary);
+            if (!readShardHeader(existing)) {
+                std::cerr << outputPath << " is not a record shard of format version "
+                          << RECORD_FORMAT_VERSION << std::endl;
+                return 1;
             }
-        } else if (param == "REMARK") {
-            processRemark(line, con);
-            if (con.resolution > -1 && con.resolution > MAX_RESOLUTION) // resolution bad
-                break;
-        } else if (param == "DBREF ") {
-            processDBRef(line, con);
-        } else if (param == "DBREF1") {
-            processDBRef1(line, con);
-        } else if (param == "SEQRES") {
-            processSequence(line, con);
-        } else if (param == "ATOM  ") { // HETATM residues are skipped
-            processAtom(line, con);
-        } else if (param == "TER   ") { // end of one chain
-            auto pdbValidity = isPDBInvalid(con);
-            // std::cout << code_name[pdbValidity] << std::endl;
-            if (pdbValidity == SUCCESS)
-                break; // terminate parser, output PDB
+        }
 
-            // if at first you don't succeed, try, try again (parse next model)
-            con.resetPDBOutput();
-        } // else ignore line, until end is reached
+        outputFile.open(outputPath, std::ios::binary | std::ios::app);
+        if (!outputFile) {
+            std::cerr << "Could not open " << outputPath << std::endl;
+            return 1;
+        }
+        if (!append && options.format == OutputFormat::BINARY)
+            writeShardHeader(outputFile);
+    } else if (options.format == OutputFormat::BINARY) {
+        writeShardHeader(std::cout);
     }
-    
-    auto pdbValidity = isPDBInvalid(con);
-    if (pdbValidity != SUCCESS) {
-        printOutput(con, false);
-        std::cerr << code_name[pdbValidity] << std::endl;
-
-        for (auto error : con.errorOutput)
-            std::cout << error << std::endl;
+    std::ostream &out = outputFile.is_open() ? outputFile : std::cout;
+
+    std::unique_ptr<RunStats> stats;
+    std::unique_ptr<PeriodicStatsWriter> statsWriter;
+    if (!statsPath.empty()) {
+        stats = std::make_unique<RunStats>("extract_pdb_coordinates",
+                                           std::vector<std::string>(stage_name, stage_name + MAX_EXTRACT_STAGES),
+                                           std::vector<std::string>(code_name, code_name + MAX_PDB_PARSING_CODES));
+        statsWriter = std::make_unique<PeriodicStatsWriter>(*stats, statsPath, statsInterval);
+    }
+    auto finishStats = [&]() {
+        if (statsWriter && !statsWriter->finish())
+            std::cerr << "Could not write " << statsPath << std::endl;
+    };
+
+    if (mode == "--process-file-stream") {
+        PDBContext con;
+        con.options = options;
+        StageClock clock(MAX_EXTRACT_STAGES);
+        if (stats) {
+            con.clock = &clock;
+            clock.switchTo(STAGE_OTHER_RECORDS);
+        }
+        auto start = std::chrono::steady_clock::now();
+        auto pdbValidity = processPDBStream(std::cin, out, con);
+        if (stats) {
+            clock.stop();
+            stats->addItem(clock, pdbValidity,
+                           std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), "-");
+        }
+        finishStats();
+        if (pdbValidity != SUCCESS)
+            std::cerr << code_name[pdbValidity] << std::endl;
         return pdbValidity;
     }
 
-    printOutput(con, true);
-
-    return SUCCESS;
-}
-
-// Part of a previouslly planned functionality
-// std::stringstream decompressGZFile(const std::string& filename) {
-//     gzFile gzfile = gzopen(filename.c_str(), "rb");
-//     if (!gzfile) {
-//         std::cout << "success: 0" << std::endl;
-//         std::cerr << "Failed to open file " << filename << std::endl;
-//         return std::stringstream();
-//     }
-    
-//     char buffer[4096];
-//     std::stringstream ss;
-//     int num_read = 0;
-//     while ((num_read = gzread(gzfile, buffer, sizeof(buffer))) > 0) {
-//         ss.write(buffer, num_read);
-//     }
-
-//     gzclose(gzfile);
-//     return ss;
-// }
+    if (paths.empty()) {
+        std::string line;
+        while (std::getline(std::cin, line) && line != "/") {
+            if (!line.empty())
+                paths.push_back(line);
+        }
+    }
 
-int main(int argc, char const *argv[]) {
-    std::ios_base::sync_with_stdio(false);
-    std::cin.tie(NULL);
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
 
-    return processPDBStream(std::cin);
-    
-    // if(argc != 2 || std::string(argv[1]) == "-h") {
-    //     std::cerr << "Usage: " << argv[0] << " (--process-file-stream | --process-files)" << std::endl;
-    //     return 1;
-    // }
-    
-    // std::string arg(argv[1]);
-    // if(arg == "--process-file-stream") {
-    //     return processPDBStream(std::cin);
-    // } else if(arg == "--process-files") {
-    //     std::string line;
-    //     while(std::getline(std::cin, line) && line != "/") {
-    //         std::cout << line << std::endl;
-    //         std::stringstream ss = decompressGZFile(line);
-    //         if(ss.rdbuf()->in_avail() > 0) {
-    //             processPDBStream(ss);
-    //         }
-    //     }
-    //     return 0;
-    // } else {
-    //     std::cerr << "Invalid argument. Usage: " << argv[0] << " (--process-file-stream | --process-files)" << std::endl;
-    //     return 1;
-    // }
+    processFiles(collectInputFiles(paths), options, out, threadCount, std::cerr, stats.get());
+    finishStats();
+    return 0;
 }
@@ -0,0 +1,274 @@
+#include "FastaInput.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <thread>
+
+#include <zlib.h>
+
+#include "BoundedQueue.h"
+
+namespace {
+
+const size_t READ_BLOCK_SIZE = 4 << 20;
+const size_t OUTPUT_BLOCK_SIZE = 4 << 20;
+// decompressed blocks buffered between the reader and the consumer
+const size_t QUEUE_CAPACITY = 8;
+// BGZF members hold at most 64 KiB each, so a job is up to 4 MiB of text
+const size_t BGZF_MEMBERS_PER_JOB = 64;
+
+const size_t GZIP_HEADER_SIZE = 12; // up to and including XLEN
+const uint8_t GZIP_FLAG_EXTRA = 4;
+
+// Buffered reader of a file that can look ahead before consuming.
+class Input {
+public:
+    explicit Input(FILE *file) : file(file) {}
+
+    // Makes at least n bytes available; false if the input ends first.
+    bool fill(size_t n) {
+        while (buffer.size() - position < n) {
+            buffer.erase(0, position);
+            position = 0;
+            size_t used = buffer.size();
+            buffer.resize(used + std::max(n, READ_BLOCK_SIZE));
+            size_t read = std::fread(&buffer[used], 1, buffer.size() - used, file);
+            buffer.resize(used + read);
+            if (read == 0)
+                return false;
+        }
+        return true;
+    }
+
+    std::string_view available() const { return std::string_view(buffer).substr(position); }
+    void skip(size_t n) { position += n; }
+    bool failed() const { return std::ferror(file); }
+
+private:
+    FILE *file;
+    std::string buffer;
+    size_t position = 0;
+};
+
+uint32_t loadLittleEndian(std::string_view bytes, size_t offset, size_t size) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < size; ++i)
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[offset + i])) << (8 * i);
+    return value;
+}
+
+bool startsWithGzipMagic(Input &input) {
+    return input.fill(2) && input.available().substr(0, 2) == "\x1f\x8b";
+}
+
+// Size of the BGZF member at the start of the input, from its "BC" extra
+// field, or 0 if the input does not start with one.
+size_t bgzfMemberSize(Input &input) {
+    if (!input.fill(GZIP_HEADER_SIZE) || !startsWithGzipMagic(input))
+        return 0;
+    std::string_view header = input.available();
+    if (!(static_cast<uint8_t>(header[3]) & GZIP_FLAG_EXTRA))
+        return 0;
+
+    size_t extraLength = loadLittleEndian(header, 10, 2);
+    if (!input.fill(GZIP_HEADER_SIZE + extraLength))
+        return 0;
+    header = input.available();
+    for (size_t i = GZIP_HEADER_SIZE; i + 4 <= GZIP_HEADER_SIZE + extraLength;) {
+        size_t fieldLength = loadLittleEndian(header, i + 2, 2);
+        if (header[i] == 'B' && header[i + 1] == 'C' && fieldLength == 2)
+            return loadLittleEndian(header, i + 4, 2) + 1;
+        i += 4 + fieldLength;
+    }
+    return 0;
+}
+
+bool readPlain(Input &input, BoundedQueue<std::string> &blocks) {
+    while (input.fill(1)) {
+        std::string block(input.available());
+        input.skip(block.size());
+        if (!blocks.push(std::move(block)))
+            break;
+    }
+    return true;
+}
+
+// Streams gzip members through one inflater. Anything after the last member
+// that is not another member is ignored, as gunzip does.
+bool readGzip(Input &input, BoundedQueue<std::string> &blocks, std::string &error) {
+    z_stream stream{};
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        error = "could not initialise zlib";
+        return false;
+    }
+
+    bool ok = true, inMember = true, outputFull = false;
+    // with a full output block, zlib may hold more output after all input is read
+    while (input.fill(1) || outputFull) {
+        std::string_view in = input.available();
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+        stream.avail_in = static_cast<uInt>(std::min<size_t>(in.size(), UINT32_MAX));
+        std::string out(OUTPUT_BLOCK_SIZE, '\0');
+        stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+        stream.avail_out = static_cast<uInt>(out.size());
+
+        const uInt offered = stream.avail_in;
+        int result = inflate(&stream, Z_NO_FLUSH);
+        input.skip(offered - stream.avail_in);
+        outputFull = stream.avail_out == 0;
+        out.resize(out.size() - stream.avail_out);
+
+        if (result == Z_STREAM_END) {
+            inflateReset(&stream);
+            inMember = startsWithGzipMagic(input);
+        } else if (result != Z_OK && result != Z_BUF_ERROR) {
+            error = std::string("corrupt gzip data (") + (stream.msg ? stream.msg : "unknown error") + ")";
+            ok = false;
+        }
+
+        if (!ok || (!out.empty() && !blocks.push(std::move(out))) || !inMember)
+            break;
+    }
+    inflateEnd(&stream);
+
+    if (ok && inMember) {
+        error = "truncated gzip data";
+        ok = false;
+    }
+    return ok;
+}
+
+struct BgzfJob {
+    std::string compressed; // whole members
+    size_t size = 0;        // total decompressed size, from the members' trailers
+};
+
+struct InflatedJob {
+    bool ok = false;
+    std::string data;
+};
+
+// Reads up to BGZF_MEMBERS_PER_JOB members into job; job stays empty at the
+// end of the input.
+bool readBgzfJob(Input &input, BgzfJob &job, std::string &error) {
+    for (size_t i = 0; i < BGZF_MEMBERS_PER_JOB; ++i) {
+        if (!input.fill(1))
+            return true;
+        size_t memberSize = bgzfMemberSize(input);
+        if (memberSize == 0) {
+            error = "expected a BGZF member";
+            return false;
+        }
+        if (memberSize < GZIP_HEADER_SIZE + 8 || !input.fill(memberSize)) {
+            error = "truncated BGZF member";
+            return false;
+        }
+        std::string_view member = input.available().substr(0, memberSize);
+        job.size += loadLittleEndian(member, memberSize - 4, 4); // ISIZE
+        job.compressed.append(member);
+        input.skip(memberSize);
+    }
+    return true;
+}
+
+InflatedJob inflateJob(const BgzfJob &job) {
+    InflatedJob inflated;
+    inflated.data.resize(job.size);
+
+    z_stream stream{};
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+        return inflated;
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(job.compressed.data()));
+    stream.avail_in = static_cast<uInt>(job.compressed.size());
+    stream.next_out = reinterpret_cast<Bytef *>(&inflated.data[0]);
+    stream.avail_out = static_cast<uInt>(inflated.data.size());
+
+    int result = Z_STREAM_END;
+    while (stream.avail_in > 0) {
+        result = inflate(&stream, Z_NO_FLUSH);
+        if (result == Z_STREAM_END)
+            inflateReset(&stream);
+        else if (result != Z_OK)
+            break;
+    }
+    inflateEnd(&stream);
+
+    inflated.ok = result == Z_STREAM_END && stream.avail_out == 0;
+    return inflated;
+}
+
+// Decompresses jobs of BGZF members on up to threadCount threads, handing
+// them over in input order.
+bool readBgzf(Input &input, unsigned threadCount, BoundedQueue<std::string> &blocks, std::string &error) {
+    std::deque<std::future<InflatedJob>> pending;
+    bool reading = true;
+    while (reading || !pending.empty()) {
+        while (reading && pending.size() < 2 * static_cast<size_t>(threadCount)) {
+            BgzfJob job;
+            if (!readBgzfJob(input, job, error))
+                return false;
+            if (job.compressed.empty()) {
+                reading = false;
+                break;
+            }
+            pending.push_back(std::async(std::launch::async, inflateJob, std::move(job)));
+        }
+        if (pending.empty())
+            break;
+
+        InflatedJob inflated = pending.front().get();
+        pending.pop_front();
+        if (!inflated.ok) {
+            error = "corrupt BGZF member";
+            return false;
+        }
+        if (!blocks.push(std::move(inflated.data)))
+            break;
+    }
+    return true;
+}
+
+} // namespace
+
+bool readInput(const std::string &path, unsigned threadCount, const ConsumeBlock &consume, std::string &error) {
+    FILE *file = path == "-" ? stdin : std::fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "Could not open " + path;
+        return false;
+    }
+
+    Input input(file);
+    BoundedQueue<std::string> blocks(QUEUE_CAPACITY);
+    bool ok = true;
+    std::string readError;
+    std::thread reader([&] {
+        if (!startsWithGzipMagic(input))
+            ok = readPlain(input, blocks);
+        else if (bgzfMemberSize(input) > 0)
+            ok = readBgzf(input, std::max(threadCount, 1u), blocks, readError);
+        else
+            ok = readGzip(input, blocks, readError);
+        if (ok && input.failed()) {
+            readError = "read error";
+            ok = false;
+        }
+        blocks.close();
+    });
+
+    std::string block;
+    while (blocks.pop(block)) {
+        if (!consume(block))
+            break;
+    }
+    blocks.close(); // stops the reader if consume did
+    reader.join();
+
+    if (file != stdin)
+        std::fclose(file);
+    if (!ok)
+        error = path + ": " + readError;
+    return ok;
+}
@@ -0,0 +1,21 @@
+#ifndef FASTAINPUT_H
+#define FASTAINPUT_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Receives the contents of an input in order, in blocks of any size; returns
+// false to stop reading.
+using ConsumeBlock = std::function<bool(std::string_view)>;
+
+// Reads the file at path ("-" for stdin) and hands its contents to consume.
+// Gzip input (single or multi-member) is decompressed, on a reader thread
+// ahead of consume. BGZF input, whose members carry their compressed size in
+// a "BC" extra field, is split into members without decompressing them, so
+// groups of members are decompressed on threadCount threads at once.
+// Returns false, with the reason in error, if the input cannot be read or is
+// corrupt.
+bool readInput(const std::string &path, unsigned threadCount, const ConsumeBlock &consume, std::string &error);
+
+#endif // FASTAINPUT_H
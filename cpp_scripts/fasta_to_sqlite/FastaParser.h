@@ -0,0 +1,107 @@
+#ifndef FASTAPARSER_H
+#define FASTAPARSER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct Record {
+    std::string id;
+    std::string sequence;
+};
+
+// Incremental parser of UniProt FASTA. Text is fed in blocks of any size,
+// lines may span blocks; complete records are collected in batches of
+// batchSize, which are handed to onBatch.
+//
+// The id of a record is the accession between the first two '|' of its
+// header (">sp|P12345|NAME_HUMAN ..."). Records without a sequence are
+// dropped.
+template <typename OnBatch>
+class FastaParser {
+public:
+    FastaParser(size_t batchSize, OnBatch onBatch) : batchSize(batchSize), onBatch(std::move(onBatch)) {
+        batch.reserve(batchSize);
+    }
+
+    void consume(std::string_view text) {
+        while (!text.empty()) {
+            size_t newline = text.find('\n');
+            if (newline == std::string_view::npos) {
+                partial.append(text);
+                return;
+            }
+            if (partial.empty()) {
+                processLine(text.substr(0, newline));
+            } else {
+                partial.append(text.substr(0, newline));
+                processLine(partial);
+                partial.clear();
+            }
+            text.remove_prefix(newline + 1);
+        }
+    }
+
+    // Processes an unterminated last line and hands over the last batch.
+    void finish() {
+        if (!partial.empty()) {
+            processLine(partial);
+            partial.clear();
+        }
+        endRecord();
+        if (!batch.empty())
+            flushBatch();
+    }
+
+    size_t recordCount() const { return records; }
+
+private:
+    void processLine(std::string_view line) {
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        if (line.empty())
+            return;
+
+        if (line[0] != '>') {
+            current.sequence.append(line);
+            return;
+        }
+
+        endRecord();
+        size_t firstPipe = line.find('|');
+        if (firstPipe == std::string_view::npos) {
+            current.id.assign(line);
+        } else {
+            size_t secondPipe = line.find('|', firstPipe + 1);
+            current.id.assign(line.substr(firstPipe + 1, secondPipe - firstPipe - 1));
+        }
+    }
+
+    void endRecord() {
+        if (!current.id.empty() && !current.sequence.empty()) {
+            batch.push_back(std::move(current));
+            ++records;
+            if (batch.size() >= batchSize)
+                flushBatch();
+        }
+        current.id.clear();
+        current.sequence.clear();
+    }
+
+    void flushBatch() {
+        onBatch(std::move(batch));
+        batch = std::vector<Record>();
+        batch.reserve(batchSize);
+    }
+
+    const size_t batchSize;
+    OnBatch onBatch;
+    std::vector<Record> batch;
+    Record current;
+    std::string partial; // start of a line that continues in the next block
+    size_t records = 0;
+};
+
+#endif // FASTAPARSER_H
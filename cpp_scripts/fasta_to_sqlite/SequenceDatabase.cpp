@@ -0,0 +1,96 @@
+#include "SequenceDatabase.h"
+
+namespace {
+
+// batches per transaction in bulk mode; without a journal, a transaction only
+// bounds how many dirty pages are kept in the cache
+const size_t BULK_COMMIT_BATCHES = 100;
+
+const char *BULK_PRAGMAS =
+    "PRAGMA journal_mode = OFF;"
+    "PRAGMA synchronous = OFF;"
+    "PRAGMA cache_size = -1048576;" // KiB, i.e. 1 GiB
+    "PRAGMA locking_mode = EXCLUSIVE;"
+    "PRAGMA temp_store = MEMORY;";
+
+} // namespace
+
+bool SequenceDatabase::open(const std::string &path, bool bulkLoad, std::string &error) {
+    close();
+    bulk = bulkLoad;
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK)
+        return fail("Could not open " + path, error);
+
+    if (bulk) {
+        if (!exec(BULK_PRAGMAS, error)
+            || !exec("CREATE TABLE IF NOT EXISTS sequences (id TEXT NOT NULL, sequence TEXT NOT NULL);", error)
+            || !exec("DROP INDEX IF EXISTS idx_id;", error))
+            return false;
+    } else if (!exec("CREATE TABLE IF NOT EXISTS sequences (id TEXT PRIMARY KEY, sequence TEXT NOT NULL);", error)) {
+        return false;
+    }
+
+    if (sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO sequences (id, sequence) VALUES (?1, ?2);", -1,
+                           &insertStatement, nullptr) != SQLITE_OK)
+        return fail("Could not prepare insert", error);
+    return true;
+}
+
+bool SequenceDatabase::insert(const std::vector<Record> &records, std::string &error) {
+    if (!inTransaction) {
+        if (!exec("BEGIN TRANSACTION;", error))
+            return false;
+        inTransaction = true;
+    }
+
+    for (const auto &record : records) {
+        // the records outlive the statement execution, so SQLite need not copy them
+        sqlite3_bind_text(insertStatement, 1, record.id.data(), static_cast<int>(record.id.size()), SQLITE_STATIC);
+        sqlite3_bind_text(insertStatement, 2, record.sequence.data(), static_cast<int>(record.sequence.size()),
+                          SQLITE_STATIC);
+        int result = sqlite3_step(insertStatement);
+        sqlite3_reset(insertStatement);
+        if (result != SQLITE_DONE)
+            return fail("Could not insert " + record.id, error);
+    }
+    sqlite3_clear_bindings(insertStatement);
+
+    if (!bulk || ++uncommittedBatches >= BULK_COMMIT_BATCHES) {
+        uncommittedBatches = 0;
+        inTransaction = false;
+        return exec("COMMIT;", error);
+    }
+    return true;
+}
+
+bool SequenceDatabase::finishLoad(std::string &error) {
+    if (inTransaction) {
+        inTransaction = false;
+        if (!exec("COMMIT;", error))
+            return false;
+    }
+    return !bulk || exec("CREATE INDEX IF NOT EXISTS idx_id ON sequences (id);", error);
+}
+
+void SequenceDatabase::close() {
+    sqlite3_finalize(insertStatement);
+    insertStatement = nullptr;
+    sqlite3_close(db);
+    db = nullptr;
+    inTransaction = false;
+    uncommittedBatches = 0;
+}
+
+bool SequenceDatabase::exec(const char *sql, std::string &error) {
+    char *message = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &message) == SQLITE_OK)
+        return true;
+    error = std::string(sql) + ": " + (message ? message : "unknown error");
+    sqlite3_free(message);
+    return false;
+}
+
+bool SequenceDatabase::fail(const std::string &what, std::string &error) {
+    error = what + ": " + (db ? sqlite3_errmsg(db) : "out of memory");
+    return false;
+}
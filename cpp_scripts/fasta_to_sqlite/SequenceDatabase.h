@@ -0,0 +1,51 @@
+#ifndef SEQUENCEDATABASE_H
+#define SEQUENCEDATABASE_H
+
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "FastaParser.h"
+
+// The sequences table of the UniProt database:
+//     sequences (id, sequence), indexed on id
+//
+// In the default mode the table is created with id as its PRIMARY KEY and
+// every batch is committed on its own. In bulk mode the database is opened
+// for a one-off load: no journal, no fsync, a large page cache and an
+// exclusive lock. A new table is created without a key, idx_id is dropped
+// before the load and rebuilt by finishLoad, so rows are appended instead of
+// being inserted into a b-tree in id order.
+class SequenceDatabase {
+public:
+    SequenceDatabase() = default;
+    SequenceDatabase(const SequenceDatabase &) = delete;
+    SequenceDatabase &operator=(const SequenceDatabase &) = delete;
+    ~SequenceDatabase() { close(); }
+
+    // Opens (or creates) the database at path and prepares it for loading.
+    // Returns false, with the reason in error, if that fails.
+    bool open(const std::string &path, bool bulk, std::string &error);
+
+    // Inserts a batch; a record whose id is already in a keyed table is
+    // skipped.
+    bool insert(const std::vector<Record> &records, std::string &error);
+
+    // Commits the last batches and, in bulk mode, builds the index on id.
+    bool finishLoad(std::string &error);
+
+    void close();
+
+private:
+    bool exec(const char *sql, std::string &error);
+    bool fail(const std::string &what, std::string &error);
+
+    sqlite3 *db = nullptr;
+    sqlite3_stmt *insertStatement = nullptr;
+    bool bulk = false;
+    bool inTransaction = false;
+    size_t uncommittedBatches = 0;
+};
+
+#endif // SEQUENCEDATABASE_H
@@ -0,0 +1,186 @@
+#ifndef SEQUENCESTORE_H
+#define SEQUENCESTORE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only store of UniProt sequences by accession (written by
+// fasta_to_sqlite --store), an alternative to the SQLite sequences table.
+// All integers are little-endian.
+//
+// header (64 bytes): magic "SEQSTORE", uint32 version, uint32 directory
+//     bits B, then uint64 record count, data offset, data size, hashes
+//     offset, offsets offset, directory offset
+// data: one record per sequence, in input order: uint8 id length, id,
+//     uint32 residue count, residues packed at 5 bits each (residue i at bits
+//     5i..5i+4 of the little-endian bit stream, 'A'..'Z' as 1..26), padded to
+//     a byte; followed by 8 zero bytes, so residues can be read 2 bytes at a
+//     time
+// hashes: uint64 hash of each id (sequenceIdHash), sorted
+// offsets: uint64 offset of the record of each hash
+// directory: uint32[2^B + 1]; entry b is the position of the first hash
+//     whose top B bits are >= b
+//
+// A lookup reads one directory entry and scans the few hashes of its bucket,
+// then compares the id stored in the record.
+const char SEQUENCE_STORE_MAGIC[8] = {'S', 'E', 'Q', 'S', 'T', 'O', 'R', 'E'};
+const uint32_t SEQUENCE_STORE_VERSION = 1;
+const size_t SEQUENCE_STORE_HEADER_SIZE = 64;
+const size_t SEQUENCE_STORE_DATA_PADDING = 8;
+
+// FNV-1a, with a final mix so the top bits (the directory bucket) depend on
+// every character
+inline uint64_t sequenceIdHash(std::string_view id) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : id) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// 5-bit code of a residue; anything but a letter is stored as 'X'
+inline uint8_t encodeStoredResidue(char residue) {
+    if (residue >= 'a' && residue <= 'z')
+        residue -= 'a' - 'A';
+    return residue >= 'A' && residue <= 'Z' ? residue - 'A' + 1 : 'X' - 'A' + 1;
+}
+
+inline char decodeStoredResidue(uint8_t code) {
+    return static_cast<char>('A' + code - 1);
+}
+
+// One sequence, viewed in place; valid while the store is open.
+struct StoredSequence {
+    std::string_view id;
+    uint32_t length = 0;
+    const uint8_t *packed = nullptr;
+
+    char operator[](size_t i) const {
+        size_t bit = 5 * i;
+        unsigned window = packed[bit / 8] | packed[bit / 8 + 1] << 8;
+        return decodeStoredResidue((window >> (bit % 8)) & 0x1f);
+    }
+
+    // residues [start, start + count)
+    std::string substr(size_t start, size_t count) const {
+        std::string residues(count, '\0');
+        for (size_t i = 0; i < count; ++i)
+            residues[i] = (*this)[start + i];
+        return residues;
+    }
+
+    std::string str() const { return substr(0, length); }
+};
+
+class SequenceStore {
+public:
+    SequenceStore() = default;
+    SequenceStore(const SequenceStore &) = delete;
+    SequenceStore &operator=(const SequenceStore &) = delete;
+    ~SequenceStore() { close(); }
+
+    // Maps the store at path. Returns false, with the reason in error, if it
+    // is missing or malformed.
+    bool open(const std::string &path, std::string &error) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "Could not open " + path;
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= SEQUENCE_STORE_HEADER_SIZE) {
+            size = info.st_size;
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            data = mapped == MAP_FAILED ? nullptr : static_cast<const uint8_t *>(mapped);
+        }
+        ::close(fd);
+
+        if (!data || std::memcmp(data, SEQUENCE_STORE_MAGIC, sizeof(SEQUENCE_STORE_MAGIC)) != 0
+            || load<uint32_t>(8) != SEQUENCE_STORE_VERSION) {
+            error = path + " is not a sequence store of version " + std::to_string(SEQUENCE_STORE_VERSION);
+            close();
+            return false;
+        }
+
+        directoryBits = load<uint32_t>(12);
+        count = load<uint64_t>(16);
+        uint64_t dataEnd = load<uint64_t>(24) + load<uint64_t>(32);
+        hashes = reinterpret_cast<const uint64_t *>(data + load<uint64_t>(40));
+        offsets = reinterpret_cast<const uint64_t *>(data + load<uint64_t>(48));
+        directory = reinterpret_cast<const uint32_t *>(data + load<uint64_t>(56));
+        bool fits = directoryBits >= 1 && directoryBits <= 32 && dataEnd <= size
+            && load<uint64_t>(40) + count * sizeof(uint64_t) <= size
+            && load<uint64_t>(48) + count * sizeof(uint64_t) <= size
+            && load<uint64_t>(56) + ((uint64_t(1) << directoryBits) + 1) * sizeof(uint32_t) <= size;
+        if (!fits) {
+            error = path + " is truncated";
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (data)
+            munmap(const_cast<uint8_t *>(data), size);
+        data = nullptr;
+        size = 0;
+        count = 0;
+    }
+
+    size_t sequenceCount() const { return count; }
+
+    // Looks up the sequence of id; false if it is not in the store.
+    bool find(std::string_view id, StoredSequence &sequence) const {
+        if (!data)
+            return false;
+        uint64_t hash = sequenceIdHash(id);
+        uint64_t bucket = hash >> (64 - directoryBits);
+        for (uint32_t i = directory[bucket]; i < directory[bucket + 1]; ++i) {
+            if (hashes[i] != hash)
+                continue;
+            const uint8_t *record = data + offsets[i];
+            std::string_view storedId(reinterpret_cast<const char *>(record + 1), record[0]);
+            if (storedId != id)
+                continue;
+            sequence.id = storedId;
+            std::memcpy(&sequence.length, record + 1 + record[0], sizeof(uint32_t));
+            sequence.packed = record + 1 + record[0] + sizeof(uint32_t);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    template <typename T>
+    T load(size_t offset) const {
+        T value;
+        std::memcpy(&value, data + offset, sizeof(value));
+        return value;
+    }
+
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    uint32_t directoryBits = 0;
+    uint64_t count = 0;
+    const uint64_t *hashes = nullptr;
+    const uint64_t *offsets = nullptr;
+    const uint32_t *directory = nullptr;
+};
+
+#endif // SEQUENCESTORE_H
@@ -0,0 +1,136 @@
+#include "SequenceStoreWriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#include "SequenceStore.h"
+
+namespace {
+
+template <typename T>
+void write(std::ofstream &out, T value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void pad(std::ofstream &out, uint64_t &offset, size_t alignment) {
+    static const char zeros[8] = {};
+    size_t padding = (alignment - offset % alignment) % alignment;
+    out.write(zeros, padding);
+    offset += padding;
+}
+
+// about 2 to 4 hashes per directory bucket
+uint32_t directoryBits(uint64_t count) {
+    uint32_t bits = 1;
+    while (bits < 32 && (uint64_t(1) << (bits + 2)) <= count)
+        ++bits;
+    return bits;
+}
+
+} // namespace
+
+bool SequenceStoreWriter::open(const std::string &storePath, std::string &error) {
+    path = storePath;
+    temporaryPath = storePath + ".tmp";
+    out.open(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "Could not create " + temporaryPath;
+        return false;
+    }
+    // the header is written last, once the sections are known
+    const char header[SEQUENCE_STORE_HEADER_SIZE] = {};
+    out.write(header, sizeof(header));
+    offset = SEQUENCE_STORE_HEADER_SIZE;
+    return true;
+}
+
+bool SequenceStoreWriter::add(const std::vector<Record> &records, std::string &error) {
+    for (const auto &record : records) {
+        if (record.id.size() > UINT8_MAX) {
+            error = "Id too long for a sequence store: " + record.id;
+            return false;
+        }
+        if (record.sequence.size() > UINT32_MAX) {
+            error = "Sequence too long for a sequence store: " + record.id;
+            return false;
+        }
+
+        packed.assign((5 * record.sequence.size() + 7) / 8 + 1, 0);
+        for (size_t i = 0; i < record.sequence.size(); ++i) {
+            uint8_t code = encodeStoredResidue(record.sequence[i]);
+            replaced += !std::isalpha(static_cast<unsigned char>(record.sequence[i]));
+            size_t bit = 5 * i;
+            unsigned shifted = code << (bit % 8);
+            packed[bit / 8] |= shifted & 0xff;
+            packed[bit / 8 + 1] |= shifted >> 8;
+        }
+        packed.pop_back(); // spill byte of the last residue, always 0
+
+        entries.push_back({sequenceIdHash(record.id), offset});
+        write(out, static_cast<uint8_t>(record.id.size()));
+        out.write(record.id.data(), record.id.size());
+        write(out, static_cast<uint32_t>(record.sequence.size()));
+        out.write(reinterpret_cast<const char *>(packed.data()), packed.size());
+        offset += 1 + record.id.size() + sizeof(uint32_t) + packed.size();
+    }
+    if (entries.size() >= UINT32_MAX) {
+        error = "Too many sequences for a sequence store";
+        return false;
+    }
+    if (!out) {
+        error = "Could not write " + temporaryPath;
+        return false;
+    }
+    return true;
+}
+
+bool SequenceStoreWriter::finish(std::string &error) {
+    const uint64_t dataSize = offset - SEQUENCE_STORE_HEADER_SIZE;
+    out.write(std::string(SEQUENCE_STORE_DATA_PADDING, '\0').data(), SEQUENCE_STORE_DATA_PADDING);
+    offset += SEQUENCE_STORE_DATA_PADDING;
+    pad(out, offset, sizeof(uint64_t));
+
+    // equal hashes keep input order, so the first of duplicate ids is found
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const Entry &a, const Entry &b) { return a.hash < b.hash; });
+
+    const uint64_t hashesOffset = offset;
+    for (const auto &entry : entries)
+        write(out, entry.hash);
+    const uint64_t offsetsOffset = hashesOffset + entries.size() * sizeof(uint64_t);
+    for (const auto &entry : entries)
+        write(out, entry.offset);
+
+    const uint64_t directoryOffset = offsetsOffset + entries.size() * sizeof(uint64_t);
+    const uint32_t bits = directoryBits(entries.size());
+    size_t position = 0;
+    for (uint64_t bucket = 0; bucket <= (uint64_t(1) << bits); ++bucket) {
+        while (position < entries.size() && (entries[position].hash >> (64 - bits)) < bucket)
+            ++position;
+        write(out, static_cast<uint32_t>(position));
+    }
+
+    out.seekp(0);
+    out.write(SEQUENCE_STORE_MAGIC, sizeof(SEQUENCE_STORE_MAGIC));
+    write(out, SEQUENCE_STORE_VERSION);
+    write(out, bits);
+    write(out, static_cast<uint64_t>(entries.size()));
+    write(out, static_cast<uint64_t>(SEQUENCE_STORE_HEADER_SIZE));
+    write(out, dataSize);
+    write(out, hashesOffset);
+    write(out, offsetsOffset);
+    write(out, directoryOffset);
+    out.close();
+
+    if (!out) {
+        error = "Could not write " + temporaryPath;
+        return false;
+    }
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        error = "Could not move " + temporaryPath + " to " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef SEQUENCESTOREWRITER_H
+#define SEQUENCESTOREWRITER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "FastaParser.h"
+
+// Writes a sequence store (see SequenceStore.h). Records are packed and
+// written as they arrive; the index is sorted and appended by finish. The
+// store is written to <path>.tmp and only renamed to path once complete.
+class SequenceStoreWriter {
+public:
+    bool open(const std::string &path, std::string &error);
+
+    bool add(const std::vector<Record> &records, std::string &error);
+
+    // Writes the index and the header, and moves the store into place.
+    bool finish(std::string &error);
+
+    // residues that were not letters, and were stored as 'X'
+    size_t replacedResidues() const { return replaced; }
+
+private:
+    struct Entry {
+        uint64_t hash;
+        uint64_t offset;
+    };
+
+    std::string path, temporaryPath;
+    std::ofstream out;
+    uint64_t offset = 0;
+    std::vector<Entry> entries;
+    std::vector<uint8_t> packed;
+    size_t replaced = 0;
+};
+
+#endif // SEQUENCESTOREWRITER_H
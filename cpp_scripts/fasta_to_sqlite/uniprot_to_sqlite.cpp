@@ -1,70 +1,136 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
-#include <sstream>
-#include <sqlite3.h>
+
+#include "BoundedQueue.h"
+#include "FastaInput.h"
+#include "FastaParser.h"
+#include "SequenceDatabase.h"
+#include "SequenceStoreWriter.h"
 
 #define CHUNK_SIZE 10000
 
-struct Record {
-    std::string id;
-    std::string sequence;
-};
+// batches parsed ahead of the inserting thread
+const size_t QUEUE_CAPACITY = 16;
 
-void chunked_insert(sqlite3* db, std::vector<Record>& records) {
-    char* zErrMsg = 0;
-    sqlite3_exec(db, "BEGIN TRANSACTION;", NULL, NULL, &zErrMsg);
-    
-    for(auto& record : records){
-        std::string sql = "INSERT INTO sequences (id, sequence) VALUES ('" + record.id + "', '" + record.sequence + "');";
-        sqlite3_exec(db, sql.c_str(), NULL, NULL, &zErrMsg);
-    }
-    
-    sqlite3_exec(db, "COMMIT;", NULL, NULL, &zErrMsg);
-    records.clear();
+std::string database_path = "uniprotkb/uniprot_sequences.db";
+std::string store_path;
+bool bulk = false;
+unsigned thread_count = 0;
+std::vector<std::string> input_paths;
+
+void print_help() {
+    std::cerr << "Usage: fasta_to_sqlite [options] [FILE...]" << std::endl
+              << "Loads the sequences of UniProt FASTA files (plain, gzip or BGZF compressed)" << std::endl
+              << "into the sequences table. Reads stdin if no FILE is given, or for '-'." << std::endl
+              << "Options:" << std::endl
+              << "  --bulk        Fast one-off load: no journal or fsync, exclusive lock, index" << std::endl
+              << "                on id built after the load. The database is corrupt if the" << std::endl
+              << "                load is interrupted." << std::endl
+              << "  --db PATH     Database file (default " << database_path << ")" << std::endl
+              << "  --store PATH  Write a compact, memory-mapped sequence store (see" << std::endl
+              << "                SequenceStore.h) instead of a database" << std::endl
+              << "  -j N          Threads for decompressing BGZF input (default 0: all cores)" << std::endl
+              << "  -h, --help    Print this help" << std::endl;
 }
 
-int main() {
-    std::ios_base::sync_with_stdio(false);
-    std::cin.tie(NULL);
-    sqlite3* db;
-    sqlite3_open("uniprotkb/uniprot_sequences.db", &db);
+// parses a whole non-negative number; false if text is anything else
+bool parse_count(const char *text, unsigned &value) {
+    const char *end = text + std::strlen(text);
+    auto [last, ec] = std::from_chars(text, end, value);
+    return ec == std::errc() && last == end && last != text;
+}
 
-    char* zErrMsg = 0;
-    sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS sequences (id TEXT PRIMARY KEY, sequence TEXT NOT NULL);", NULL, NULL, &zErrMsg);
-    // sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS idx_id ON sequences (id);", NULL, NULL, &zErrMsg);
-    // sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS idx_sequence ON sequences (sequence);", NULL, NULL, &zErrMsg);
-    
-    std::vector<Record> records;
-    std::string line, uniprot_id, sequence;
-    while(std::getline(std::cin, line)) {
-        if(line[0] == '>') {
-            if(!uniprot_id.empty() && !sequence.empty()) {
-                records.push_back({uniprot_id, sequence});
-                sequence.clear();
-                
-                if(records.size() >= CHUNK_SIZE){
-                    chunked_insert(db, records);
-                }
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--bulk") == 0) {
+            bulk = true;
+        } else if (std::strcmp(argv[i], "--db") == 0 && i + 1 < argc) {
+            database_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--store") == 0 && i + 1 < argc) {
+            store_path = argv[++i];
+        } else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            if (!parse_count(argv[++i], thread_count)) {
+                std::cerr << "Invalid thread count: " << argv[i] << std::endl;
+                print_help();
+                return 1;
             }
-
-            // Extracting Uniprot ID
-            int first_pipe = line.find("|");
-            int second_pipe = line.find("|", first_pipe + 1);
-            uniprot_id = line.substr(first_pipe + 1, second_pipe - first_pipe - 1);
+        } else if (std::strcmp(argv[i], "-h") == 0 || std::strcmp(argv[i], "--help") == 0) {
+            print_help();
+            return 0;
+        } else if (argv[i][0] != '-' || std::strcmp(argv[i], "-") == 0) {
+            input_paths.push_back(argv[i]);
         } else {
-            sequence += line;
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            print_help();
+            return 1;
         }
     }
-    
-    if(!uniprot_id.empty() && !sequence.empty()){
-        records.push_back({uniprot_id, sequence});
+    if (input_paths.empty())
+        input_paths.push_back("-");
+    if (thread_count == 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    const bool to_store = !store_path.empty();
+    SequenceDatabase db;
+    SequenceStoreWriter store;
+    std::string error;
+    if (to_store ? !store.open(store_path, error) : !db.open(database_path, bulk, error)) {
+        std::cerr << error << std::endl;
+        return 1;
     }
-    
-    if(!records.empty()){
-        chunked_insert(db, records);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // parsing on its own thread, insertion on the main thread
+    BoundedQueue<std::vector<Record>> batches(QUEUE_CAPACITY);
+    size_t record_count = 0;
+    std::string read_error;
+    std::thread parser([&] {
+        bool stopped = false; // insertion failed, the rest of the input is not needed
+        auto push = [&](std::vector<Record> &&batch) { stopped |= !batches.push(std::move(batch)); };
+        FastaParser<decltype(push)> fasta(CHUNK_SIZE, push);
+        auto consume = [&](std::string_view block) {
+            fasta.consume(block);
+            return !stopped;
+        };
+        for (const auto &path : input_paths) {
+            if (stopped || !readInput(path, thread_count, consume, read_error))
+                break;
+            fasta.finish();
+        }
+        record_count = fasta.recordCount();
+        batches.close();
+    });
+
+    bool ok = true;
+    std::vector<Record> batch;
+    while (ok && batches.pop(batch))
+        ok = to_store ? store.add(batch, error) : db.insert(batch, error);
+    batches.close(); // unblocks the parser if insertion failed
+    parser.join();
+
+    if (ok && !read_error.empty()) {
+        error = read_error;
+        ok = false;
+    }
+    if (ok)
+        ok = to_store ? store.finish(error) : db.finishLoad(error);
+    if (!ok) {
+        std::cerr << error << std::endl;
+        return 1;
     }
-    
-    sqlite3_close(db);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Loaded " << record_count << " sequences in " << seconds << " s ("
+              << static_cast<size_t>(record_count / std::max(seconds, 1e-9)) << " rows/s)" << std::endl;
+    if (to_store && store.replacedResidues() > 0)
+        std::cerr << store.replacedResidues() << " residues that were not letters were stored as X" << std::endl;
     return 0;
 }
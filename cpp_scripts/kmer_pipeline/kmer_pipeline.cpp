@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../extract_pdb_coordinates/BatchProcessor.h"
+#include "../extract_pdb_coordinates/Constants.h"
+#include "../extract_pdb_coordinates/GZStreamBuf.h"
+#include "../extract_pdb_coordinates/PDBContext.h"
+#include "../extract_pdb_coordinates/PDBParser.h"
+#include "../fasta_to_sqlite/BoundedQueue.h"
+#include "../fasta_to_sqlite/SequenceStore.h"
+#include "../post_process_kmers/KmerCorpus.h"
+#include "../post_process_kmers/KmerCounts.h"
+#include "../post_process_kmers/Parallel.h"
+#include "../post_process_kmers/SpillRuns.h"
+#include "../post_process_kmers/UniprotIndex.h"
+
+// Extracts the proximity k-mers of PDB files and counts them in one process,
+// without intermediate files: the work of extract_pdb_coordinates,
+// kmers/pipeline.py and post_process_kmers.
+//
+// Every worker thread takes one file at a time through decompression,
+// parsing, neighbour search and (with -a) counting into its own KmerCounts,
+// and hands a summary of it to the main thread through a bounded queue. The
+// main thread tallies the parsing codes, writes the optional corpus, and
+// collects the UniProt matches; without -a, the k-mers go to the corpus (a
+// temporary one without --corpus), and the representative PDB of every
+// UniProt entry is counted from it once all files are done.
+
+namespace {
+
+struct PipelineOptions {
+    bool allPdbs = false;
+    std::string uniprotStorePath;
+    std::string corpusPath; // empty: no corpus
+    std::string uniprotIndexPath; // empty: no UniProt index
+    unsigned int threadCount = 1;
+    size_t memoryLimitMb = 0; // 0: no limit
+};
+
+// What a worker passes on about one file.
+struct ParsedPdb {
+    PDBParsingCode code = FILE_NOT_READABLE;
+    std::string pdbId;
+    std::string uniprotId;
+    float resolution = -1.0f;
+    int sequenceLength = 0;
+    uint32_t kmerCount = 0;
+    std::string kmers; // one per line; only kept for the corpus
+};
+
+// Per-thread state, kept between files so that parsing a file does not
+// allocate new buffers.
+struct PipelineWorker {
+    GZStreamBuf gzBuffer;
+    std::istream in{&gzBuffer};
+    std::ostream discard{nullptr};
+    PDBContext con;
+    std::unique_ptr<KmerCounts> counts; // with -a
+
+    // Parses file and computes its k-mers: counted into counts if there are
+    // any, and kept in parsed.kmers if keepKmers.
+    void processFile(const std::string &file, bool keepKmers, ParsedPdb &parsed) {
+        parsed = ParsedPdb();
+        con.sourcePath = file;
+
+        if (gzBuffer.open(file)) {
+            in.clear();
+            try {
+                parsed.code = processPDBStream(in, discard, con);
+            } catch (const std::exception &) {
+                parsed.code = UNEXPECTED_ERROR;
+            }
+            if (gzBuffer.hasError())
+                parsed.code = FILE_NOT_READABLE;
+            gzBuffer.close();
+        }
+        if (parsed.code != SUCCESS)
+            return;
+
+        parsed.pdbId = con.pdbId;
+        parsed.uniprotId = con.matchedUniprotId;
+        parsed.resolution = con.resolution;
+        parsed.sequenceLength = con.parsedSequence.size();
+        parsed.kmerCount = con.output.size();
+
+        con.grid.build(con.output, KMER_RADIUS);
+        for (size_t i = 0; i < con.output.size(); ++i) {
+            const std::string &kmer = con.grid.kmer(i, con.options.maxKmerLength);
+            if (counts)
+                countKmerLines(kmer, *counts);
+            if (keepKmers) {
+                parsed.kmers += kmer;
+                parsed.kmers += '\n';
+            }
+        }
+    }
+};
+
+void printUsage(const char *program) {
+    std::cout << "Usage: " << program << " [OPTIONS] [PATH ...]\n"
+              << "Counts the proximity k-mers of the .ent.gz files in PATH (directories are\n"
+              << "searched recursively; default pdb), like extract_pdb_coordinates followed\n"
+              << "by post_process_kmers, in one pass and without intermediate files.\n"
+              << "Options:\n"
+              << "  -a            Count all PDBs\n"
+              << "  --uniprot-store <file>\n"
+              << "                Without -a: match PDBs against the UniProt sequences in\n"
+              << "                <file> (fasta_to_sqlite --store) and count the representative\n"
+              << "                PDB of each UniProt entry\n"
+              << "  -k <value>    Specify the size of the k-mers, or a range of sizes\n"
+              << "                (e.g. 6-20) to count in one pass\n"
+              << "  -o <prefix>   Output prefix for a range of sizes; the k-mers of\n"
+              << "                size K go to <prefix>K.txt (default kmers_k)\n"
+              << "  -j <threads>  Number of worker threads (0 = all cores, default 1)\n"
+              << "  --kmer-length <length>\n"
+              << "                Only keep the closest <length> residues of each k-mer\n"
+              << "  --top <n>     Print only the n most frequent k-mers\n"
+              << "  --approximate With --top, count with bounded memory (Count-Min +\n"
+              << "                Space-Saving); prints \"kmer count lower upper\"\n"
+              << "  --memory-limit <MB>\n"
+              << "                With --top, switch to approximate counting when the\n"
+              << "                exact tables outgrow this limit\n"
+              << "  --epsilon <e> Approximate counts are at most e * (total k-mers)\n"
+              << "                too high (default 1e-5)...\n"
+              << "  --delta <d>   ...with probability 1 - d (default 0.01)\n"
+              << "  --corpus <file>\n"
+              << "                Also append the k-mers of every valid PDB to the k-mer\n"
+              << "                corpus <file> (and <file>.idx), for post_process_kmers\n"
+              << "  --uniprot-index <file>\n"
+              << "                Also write the UniProt matches to <file>\n"
+              << "  -h, --help    Display this help message and exit\n";
+}
+
+void printProgress(size_t done, size_t total) {
+    std::cerr << "\rProcessed " << done << " / " << total << "; " << std::fixed << std::setprecision(2)
+              << static_cast<double>(done) / std::max<size_t>(total, 1) * 100 << "%";
+    std::cerr.flush();
+}
+
+// Runs the workers over files, collects their results and writes the counts
+// of all PDBs, or of the representatives of the UniProt entries. Returns the
+// exit code.
+int runPipeline(const std::vector<std::string> &files, const ParserOptions &parserOptions,
+                const PipelineOptions &options, const CountOptions &countOptions) {
+    auto start = std::chrono::steady_clock::now();
+    const unsigned int threadCount = options.threadCount;
+    const bool keepKmers = !options.allPdbs || !options.corpusPath.empty();
+
+    // without -a, the representatives are read back from the corpus, so that
+    // only their position is held until all files are parsed
+    std::string corpusPath = options.corpusPath;
+    SpillDirectory temporaryDirectory;
+    if (corpusPath.empty() && !options.allPdbs) {
+        std::string error;
+        if (!temporaryDirectory.create(std::filesystem::temp_directory_path().string(), error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        corpusPath = temporaryDirectory.newRunPath();
+    }
+
+    KmerCorpusWriter corpus;
+    if (!corpusPath.empty()) {
+        std::string error;
+        if (!corpus.open(corpusPath, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<PipelineWorker> workers(threadCount);
+    for (auto &worker : workers) {
+        worker.con.options = parserOptions;
+        if (options.allPdbs)
+            worker.counts = std::make_unique<KmerCounts>(countOptions);
+    }
+
+    BoundedQueue<ParsedPdb> parsedQueue(4 * threadCount);
+    std::atomic<size_t> nextFile{0};
+    std::atomic<unsigned int> running{threadCount};
+    std::mutex logMutex;
+
+    // a thread that outgrows its share of --memory-limit continues with
+    // bounded-memory sketches
+    auto limitMemory = [&](KmerCounts &counts) {
+        if (options.memoryLimitMb && !counts.sketching
+            && counts.memoryBytes() > options.memoryLimitMb * 1000000 / threadCount) {
+            counts.startSketching();
+            std::lock_guard<std::mutex> lock(logMutex);
+            std::cerr << std::endl << "Memory limit reached, counting approximately from here on" << std::endl;
+        }
+    };
+
+    auto work = [&](PipelineWorker &worker) {
+        ParsedPdb parsed;
+        for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+            worker.processFile(files[i], keepKmers, parsed);
+            parsedQueue.push(std::move(parsed));
+            if (worker.counts)
+                limitMemory(*worker.counts);
+        }
+        if (--running == 0)
+            parsedQueue.close();
+    };
+
+    std::vector<std::thread> threads;
+    for (auto &worker : workers)
+        threads.emplace_back(work, std::ref(worker));
+
+    // UniProt entries and their PDBs
+    std::vector<UniprotGroup> groups;
+    std::unordered_map<std::string, size_t> groupOf; // uniprot id -> position in groups
+    std::vector<size_t> codeCounts(MAX_PDB_PARSING_CODES, 0);
+    size_t done = 0;
+
+    ParsedPdb parsed;
+    while (parsedQueue.pop(parsed)) {
+        codeCounts[parsed.code]++;
+        if (parsed.code == SUCCESS) {
+            if (!corpusPath.empty())
+                corpus.add(parsed.pdbId, parsed.kmers, parsed.kmerCount);
+            if (!options.allPdbs) {
+                auto [it, added] = groupOf.emplace(parsed.uniprotId, groups.size());
+                if (added)
+                    groups.push_back({parsed.uniprotId, {}});
+                groups[it->second].pdbs.push_back({parsed.pdbId, parsed.resolution, parsed.sequenceLength});
+            }
+        }
+
+        if (++done % 100 == 0 || done == files.size()) {
+            std::lock_guard<std::mutex> lock(logMutex);
+            printProgress(done, files.size());
+        }
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << std::endl << "Parsed " << files.size() << " files in " << std::fixed << std::setprecision(2)
+              << seconds << " s" << std::endl;
+    for (size_t code = 0; code < MAX_PDB_PARSING_CODES; ++code) {
+        if (codeCounts[code])
+            std::cerr << code_name[code] << ": " << codeCounts[code] << std::endl;
+    }
+
+    if (!corpus.close()) {
+        std::cerr << "Could not write " << corpusPath << std::endl;
+        return 1;
+    }
+    if (!options.uniprotIndexPath.empty() && !writeUniprotIndex(options.uniprotIndexPath, groups)) {
+        std::cerr << "Could not write " << options.uniprotIndexPath << std::endl;
+        return 1;
+    }
+
+    std::vector<KmerCounts> threadCounts;
+    if (options.allPdbs) {
+        for (auto &worker : workers)
+            threadCounts.push_back(std::move(*worker.counts));
+    } else {
+        for (unsigned int t = 0; t < threadCount; ++t)
+            threadCounts.emplace_back(countOptions);
+
+        KmerCorpus corpusReader;
+        std::string error;
+        if (!corpusReader.open(corpusPath, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+
+        // in file order, for sequential reads of the mapped corpus
+        std::vector<const KmerCorpus::Entry *> representatives;
+        for (const auto &pdbId : selectRepresentatives(groups, threadCount))
+            representatives.push_back(corpusReader.find(pdbId));
+        std::sort(representatives.begin(), representatives.end(),
+                  [](const KmerCorpus::Entry *a, const KmerCorpus::Entry *b) { return a->offset < b->offset; });
+        corpusReader.adviseSequential();
+
+        std::cerr << "Counting the representatives of " << representatives.size() << " UniProt entries"
+                  << std::endl;
+        parallelFor(representatives.size(), threadCount, [&](size_t i, unsigned int thread) {
+            countKmerLines(corpusReader.kmers(*representatives[i]), threadCounts[thread]);
+            limitMemory(threadCounts[thread]);
+        });
+    }
+    std::cerr << "Prepairing results..." << std::endl;
+
+    return writeSizes(threadCounts, &KmerCounts::packed, countOptions, threadCount, nullptr)
+        || writeSizes(threadCounts, &KmerCounts::widePacked, countOptions, threadCount, nullptr)
+        || writeSizes(threadCounts, &KmerCounts::strings, countOptions, threadCount, nullptr);
+}
+
+} // namespace
+
+int main(int argc, char const *argv[]) {
+    std::ios_base::sync_with_stdio(false);
+
+    PipelineOptions options;
+    CountOptions countOptions;
+    ParserOptions parserOptions;
+    parserOptions.format = OutputFormat::NONE;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg == "-a") {
+            options.allPdbs = true;
+        } else if (arg == "--uniprot-store" && i + 1 < argc) {
+            options.uniprotStorePath = argv[++i];
+        } else if (arg == "-k" && i + 1 < argc) {
+            if (!parseKmerSizes(argv[++i], countOptions)) {
+                std::cerr << "Invalid k-mer size: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "-o" && i + 1 < argc) {
+            countOptions.output_prefix = argv[++i];
+        } else if (arg == "-j" && i + 1 < argc) {
+            options.threadCount = std::stoi(argv[++i]);
+        } else if (arg == "--kmer-length" && i + 1 < argc) {
+            parserOptions.maxKmerLength = std::stoul(argv[++i]);
+        } else if (arg == "--top" && i + 1 < argc) {
+            countOptions.top_kmers = std::stoul(argv[++i]);
+        } else if (arg == "--approximate") {
+            countOptions.approximate = true;
+        } else if (arg == "--memory-limit" && i + 1 < argc) {
+            options.memoryLimitMb = std::stoul(argv[++i]);
+        } else if (arg == "--epsilon" && i + 1 < argc) {
+            countOptions.sketch_parameters.epsilon = std::stod(argv[++i]);
+        } else if (arg == "--delta" && i + 1 < argc) {
+            countOptions.sketch_parameters.delta = std::stod(argv[++i]);
+        } else if (arg == "--corpus" && i + 1 < argc) {
+            options.corpusPath = argv[++i];
+        } else if (arg == "--uniprot-index" && i + 1 < argc) {
+            options.uniprotIndexPath = argv[++i];
+        } else if (!arg.empty() && arg[0] != '-') {
+            paths.push_back(arg);
+        } else {
+            std::cerr << "Invalid argument: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!options.allPdbs && options.uniprotStorePath.empty()) {
+        std::cerr << "Either -a or --uniprot-store is required" << std::endl;
+        return 1;
+    }
+    if ((countOptions.approximate || options.memoryLimitMb) && !countOptions.top_kmers) {
+        std::cerr << "--approximate and --memory-limit require --top" << std::endl;
+        return 1;
+    }
+    SketchParameters &sketchParameters = countOptions.sketch_parameters;
+    if (sketchParameters.epsilon <= 0 || sketchParameters.delta <= 0 || sketchParameters.delta >= 1) {
+        std::cerr << "--epsilon must be positive and --delta in (0, 1)" << std::endl;
+        return 1;
+    }
+    sketchParameters.top = countOptions.top_kmers;
+    options.threadCount = resolveThreadCount(options.threadCount);
+
+    SequenceStore uniprotStore;
+    if (!options.allPdbs) {
+        std::string error;
+        if (!uniprotStore.open(options.uniprotStorePath, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        parserOptions.uniprotStore = &uniprotStore;
+    }
+
+    if (paths.empty())
+        paths.push_back("pdb");
+    std::vector<std::string> files = collectInputFiles(paths);
+    std::cerr << "Processing " << files.size() << " PDB files on " << options.threadCount << " threads" << std::endl;
+
+    return runPipeline(files, parserOptions, options, countOptions);
+}
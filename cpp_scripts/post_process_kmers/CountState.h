@@ -0,0 +1,182 @@
+#ifndef COUNTSTATE_H
+#define COUNTSTATE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "KmerCorpus.h"
+#include "KmerTable.h"
+
+// The k-mer counts of a run (post_process_kmers --state), with the corpus
+// entries they were counted from, so that the next run only counts the PDBs
+// whose entries were added or removed since: the k-mers of a removed entry are
+// still in the corpus data, which is only ever appended to, and are
+// subtracted.
+//
+// Binary, little endian:
+//   header: magic "KMERSTAT", uint32 version, uint32 flags (1: all PDBs, -a),
+//       int32 smallest and largest k-mer size, uint64 PDB count
+//   per PDB: uint8 id length, id, uint64 corpus offset and length
+//   per k-mer size, smallest first: uint64 k-mer count, then per k-mer its
+//       packed key (a uint64 up to MAX_PACKED_KMER_SIZE, two above, low half
+//       first) and a uint32 count
+// Only sizes up to MAX_WIDE_PACKED_KMER_SIZE are kept.
+const char COUNT_STATE_MAGIC[8] = {'K', 'M', 'E', 'R', 'S', 'T', 'A', 'T'};
+const uint32_t COUNT_STATE_VERSION = 2; // 2: '.' packs below 'A'
+const uint32_t COUNT_STATE_ALL_PDBS = 1;
+
+struct CountStateHeader {
+    uint32_t flags;
+    int32_t minSize;
+    int32_t maxSize;
+};
+
+namespace count_state {
+
+template <typename T>
+inline void write(std::ostream &out, const T &value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+inline bool read(std::istream &in, T &value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+inline void writeKey(std::ostream &out, uint64_t key) { write(out, key); }
+inline void writeKey(std::ostream &out, WidePackedKmer key) {
+    write(out, static_cast<uint64_t>(key));
+    write(out, static_cast<uint64_t>(key >> 64));
+}
+
+inline bool readKey(std::istream &in, uint64_t &key) { return read(in, key); }
+inline bool readKey(std::istream &in, WidePackedKmer &key) {
+    uint64_t low, high;
+    if (!read(in, low) || !read(in, high))
+        return false;
+    key = (WidePackedKmer(high) << 64) | low;
+    return true;
+}
+
+} // namespace count_state
+
+// Reads a state front to back: open, then readTable once per size, smallest
+// first.
+class CountStateReader {
+public:
+    // Opens the state at path and reads its PDB entries. Returns false, with
+    // the reason in error, if it is missing or malformed, or was written with
+    // other options than expected.
+    bool open(const std::string &path, const CountStateHeader &expected, std::string &error) {
+        in.open(path, std::ios::binary);
+        char magic[sizeof(COUNT_STATE_MAGIC)];
+        uint32_t version = 0;
+        CountStateHeader header{};
+        uint64_t pdbCount = 0;
+        if (!in.read(magic, sizeof(magic)) || std::string(magic, sizeof(magic)) != std::string(COUNT_STATE_MAGIC, sizeof(magic))
+            || !count_state::read(in, version) || version != COUNT_STATE_VERSION) {
+            error = path + " is not a k-mer count state of version " + std::to_string(COUNT_STATE_VERSION);
+            return false;
+        }
+        if (!count_state::read(in, header.flags) || !count_state::read(in, header.minSize)
+            || !count_state::read(in, header.maxSize) || !count_state::read(in, pdbCount)) {
+            error = path + " is truncated";
+            return false;
+        }
+        if (header.flags != expected.flags || header.minSize != expected.minSize || header.maxSize != expected.maxSize) {
+            error = path + " holds counts of other k-mer sizes, or other PDBs";
+            return false;
+        }
+
+        entries.resize(pdbCount);
+        for (auto &entry : entries) {
+            uint8_t idLength = 0;
+            entry.pdbId.resize(count_state::read(in, idLength) ? idLength : 0);
+            if (!in.read(entry.pdbId.data(), idLength) || !count_state::read(in, entry.offset)
+                || !count_state::read(in, entry.length)) {
+                error = path + " is truncated";
+                return false;
+            }
+            entry.count = 0;
+        }
+        return true;
+    }
+
+    // corpus entries the counts were taken from
+    const std::vector<KmerCorpus::Entry> &pdbs() const { return entries; }
+
+    // Adds the counts of the next k-mer size to table.
+    template <typename Key>
+    bool readTable(PartitionedKmerTable<Key> &table) {
+        uint64_t kmerCount = 0;
+        if (!count_state::read(in, kmerCount))
+            return false;
+        Key key;
+        uint32_t count;
+        for (uint64_t i = 0; i < kmerCount; ++i) {
+            if (!count_state::readKey(in, key) || !count_state::read(in, count))
+                return false;
+            table.add(key, count);
+        }
+        return true;
+    }
+
+private:
+    std::ifstream in;
+    std::vector<KmerCorpus::Entry> entries;
+};
+
+// Writes a state to <path>.tmp, front to back, and replaces path with it in
+// commit, so an interrupted run leaves the previous state.
+class CountStateWriter {
+public:
+    bool open(const std::string &statePath, const CountStateHeader &header,
+              const std::vector<const KmerCorpus::Entry *> &pdbs) {
+        path = statePath;
+        out.open(path + ".tmp", std::ios::binary | std::ios::trunc);
+        out.write(COUNT_STATE_MAGIC, sizeof(COUNT_STATE_MAGIC));
+        count_state::write(out, COUNT_STATE_VERSION);
+        count_state::write(out, header.flags);
+        count_state::write(out, header.minSize);
+        count_state::write(out, header.maxSize);
+        count_state::write(out, static_cast<uint64_t>(pdbs.size()));
+        for (const auto *entry : pdbs) {
+            count_state::write(out, static_cast<uint8_t>(entry->pdbId.size()));
+            out.write(entry->pdbId.data(), entry->pdbId.size());
+            count_state::write(out, entry->offset);
+            count_state::write(out, entry->length);
+        }
+        return static_cast<bool>(out);
+    }
+
+    // Writes the counts of the next k-mer size; k-mers counted 0 times are
+    // left out.
+    template <typename Key>
+    void writeTable(const std::vector<std::pair<Key, uint32_t>> &kmers) {
+        uint64_t kmerCount = 0;
+        for (const auto &kmer : kmers)
+            kmerCount += kmer.second != 0;
+        count_state::write(out, kmerCount);
+        for (const auto &[key, count] : kmers) {
+            if (count == 0)
+                continue;
+            count_state::writeKey(out, key);
+            count_state::write(out, count);
+        }
+    }
+
+    bool commit() {
+        out.close();
+        return out && std::rename((path + ".tmp").c_str(), path.c_str()) == 0;
+    }
+
+private:
+    std::string path;
+    std::ofstream out;
+};
+
+#endif // COUNTSTATE_H
@@ -0,0 +1,244 @@
+#ifndef HEAVYHITTERS_H
+#define HEAVYHITTERS_H
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "KmerTable.h"
+
+// Bounded-memory approximation of the most frequent k-mers, for when the
+// exact tables do not fit in memory. Every k-mer is added to a Count-Min
+// sketch, which never underestimates a count and overestimates it by at most
+// epsilon * (total count) with probability 1 - delta, and to a Space-Saving
+// summary, which keeps candidate heavy hitters with a guaranteed lower bound.
+struct SketchParameters {
+    double epsilon = 1e-5;
+    double delta = 0.01;
+    size_t top = 10000;
+};
+
+// Count-Min sketch with conservative update: only the counters holding the
+// current minimum of a key are incremented.
+class CountMinSketch {
+public:
+    CountMinSketch(double epsilon, double delta)
+        : width(static_cast<size_t>(std::ceil(std::exp(1.0) / epsilon))),
+          depth(std::max<size_t>(1, static_cast<size_t>(std::ceil(std::log(1.0 / delta))))),
+          cells(width * depth, 0) {}
+
+    void add(uint64_t hash, uint32_t count = 1) {
+        uint32_t target = estimate(hash) + count;
+        for (size_t row = 0; row < depth; ++row) {
+            uint32_t &cell = cells[index(row, hash)];
+            cell = std::max(cell, target);
+        }
+        total += count;
+    }
+
+    uint32_t estimate(uint64_t hash) const {
+        uint32_t minimum = UINT32_MAX;
+        for (size_t row = 0; row < depth; ++row)
+            minimum = std::min(minimum, cells[index(row, hash)]);
+        return minimum;
+    }
+
+    // sketch of both streams; other must have the same dimensions
+    void merge(const CountMinSketch &other) {
+        for (size_t i = 0; i < cells.size(); ++i)
+            cells[i] += other.cells[i];
+        total += other.total;
+    }
+
+    // number of k-mers added, the L in the epsilon * L error bound
+    uint64_t totalCount() const { return total; }
+    size_t memoryBytes() const { return cells.size() * sizeof(uint32_t); }
+
+private:
+    // row hashes by double hashing from one 64-bit key hash
+    size_t index(size_t row, uint64_t hash) const {
+        uint64_t rowHash = (hash & 0xffffffffULL) + row * ((hash >> 32) | 1);
+        return row * width + rowHash % width;
+    }
+
+    size_t width;
+    size_t depth;
+    std::vector<uint32_t> cells;
+    uint64_t total = 0;
+};
+
+// Space-Saving summary of at most capacity counters. A k-mer that is not
+// tracked replaces the one with the smallest count, and inherits that count
+// as its possible overestimate (error).
+template <typename Key>
+class SpaceSaving {
+public:
+    struct Counter {
+        Key key;
+        uint64_t count;
+        uint64_t error;
+    };
+
+    explicit SpaceSaving(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {
+        heap.reserve(this->capacity);
+        positions.reserve(this->capacity);
+    }
+
+    void add(const Key &key, uint64_t count = 1) {
+        auto it = positions.find(key);
+        if (it != positions.end()) {
+            heap[it->second].count += count;
+            siftDown(it->second);
+        } else if (heap.size() < capacity) {
+            positions.emplace(key, heap.size());
+            heap.push_back({key, count, 0});
+            siftUp(heap.size() - 1);
+        } else {
+            Counter &smallest = heap[0];
+            positions.erase(smallest.key);
+            positions.emplace(key, 0);
+            smallest.error = smallest.count;
+            smallest.count += count;
+            smallest.key = key;
+            siftDown(0);
+        }
+    }
+
+    bool full() const { return heap.size() == capacity; }
+
+    // upper bound on the count of every k-mer that is not tracked
+    uint64_t untrackedBound() const { return full() ? heap[0].count : 0; }
+
+    const std::vector<Counter> &counters() const { return heap; }
+
+    // counter of key, or nullptr if it is not tracked
+    const Counter *find(const Key &key) const {
+        auto it = positions.find(key);
+        return it == positions.end() ? nullptr : &heap[it->second];
+    }
+
+private:
+    struct Hash {
+        size_t operator()(const Key &key) const { return KmerKeyTraits<Key>::hash(key); }
+    };
+
+    // min-heap on count; positions follows every move
+    void swapCounters(size_t a, size_t b) {
+        std::swap(heap[a], heap[b]);
+        positions[heap[a].key] = a;
+        positions[heap[b].key] = b;
+    }
+
+    void siftUp(size_t i) {
+        while (i > 0 && heap[i].count < heap[(i - 1) / 2].count) {
+            swapCounters(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+
+    void siftDown(size_t i) {
+        for (;;) {
+            size_t smallest = i;
+            for (size_t child = 2 * i + 1; child <= 2 * i + 2 && child < heap.size(); ++child)
+                if (heap[child].count < heap[smallest].count)
+                    smallest = child;
+            if (smallest == i)
+                return;
+            swapCounters(i, smallest);
+            i = smallest;
+        }
+    }
+
+    size_t capacity;
+    std::vector<Counter> heap;
+    std::unordered_map<Key, size_t, Hash> positions;
+};
+
+// A reported heavy hitter: true count is in [lower, upper], where lower
+// holds with probability 1 - delta and upper always holds.
+template <typename Key>
+struct HeavyHitter {
+    Key key;
+    uint64_t count;
+    uint64_t lower;
+    uint64_t upper;
+};
+
+template <typename Key>
+class HeavyHitterSketch {
+public:
+    explicit HeavyHitterSketch(const SketchParameters &parameters)
+        : parameters(parameters),
+          frequencies(parameters.epsilon, parameters.delta),
+          candidates(std::max(2 * parameters.top, static_cast<size_t>(std::ceil(1.0 / parameters.epsilon)))) {}
+
+    void add(const Key &key, uint32_t count = 1) {
+        frequencies.add(KmerKeyTraits<Key>::hash(key), count);
+        candidates.add(key, count);
+    }
+
+    // adds every count of an exact table
+    void add(const KmerTable<Key> &table) {
+        table.forEach([&](const Key &key, uint32_t count) { add(key, count); });
+    }
+
+    size_t memoryBytes() const { return frequencies.memoryBytes(); }
+
+    // Top parameters.top k-mers over the streams of all sketches, most
+    // frequent first. The Count-Min sketches are summed; a candidate's
+    // Space-Saving bounds are summed over all summaries, counting a summary
+    // that does not track it with 0 (lower) and its untracked bound (upper).
+    static std::vector<HeavyHitter<Key>> merge(const std::vector<HeavyHitterSketch *> &sketches) {
+        std::vector<HeavyHitter<Key>> result;
+        if (sketches.empty())
+            return result;
+
+        CountMinSketch &frequencies = sketches[0]->frequencies;
+        for (size_t s = 1; s < sketches.size(); ++s)
+            frequencies.merge(sketches[s]->frequencies);
+        const SketchParameters &parameters = sketches[0]->parameters;
+        uint64_t maxOverestimate = static_cast<uint64_t>(std::ceil(parameters.epsilon * frequencies.totalCount()));
+
+        KmerTable<Key> seen;
+        for (const auto *sketch : sketches) {
+            for (const auto &candidate : sketch->candidates.counters()) {
+                if (seen.count(candidate.key))
+                    continue;
+                seen.add(candidate.key);
+
+                uint64_t lower = 0, upper = 0;
+                for (const auto *other : sketches) {
+                    const auto *counter = other->candidates.find(candidate.key);
+                    lower += counter ? counter->count - counter->error : 0;
+                    upper += counter ? counter->count : other->candidates.untrackedBound();
+                }
+
+                uint64_t estimate = frequencies.estimate(KmerKeyTraits<Key>::hash(candidate.key));
+                upper = std::min(upper, estimate);
+                lower = std::max(lower, estimate > maxOverestimate ? estimate - maxOverestimate : 0);
+                result.push_back({candidate.key, upper, std::min(lower, upper), upper});
+            }
+        }
+
+        auto byCount = [](const HeavyHitter<Key> &a, const HeavyHitter<Key> &b) {
+            return a.count > b.count || (a.count == b.count && a.key < b.key);
+        };
+        if (result.size() > parameters.top) {
+            std::partial_sort(result.begin(), result.begin() + parameters.top, result.end(), byCount);
+            result.resize(parameters.top);
+        } else {
+            std::sort(result.begin(), result.end(), byCount);
+        }
+        return result;
+    }
+
+private:
+    SketchParameters parameters;
+    CountMinSketch frequencies;
+    SpaceSaving<Key> candidates;
+};
+
+#endif // HEAVYHITTERS_H
@@ -0,0 +1,69 @@
+#ifndef KMERCODEC_H
+#define KMERCODEC_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// k-mers of up to 12 residues are packed into a uint64_t, 5 bits per residue,
+// first residue in the most significant bits. '.' maps to 1 and 'A'-'Z' to
+// 2-27, in ASCII order, so packed k-mers of the same size compare like the
+// strings, and the prefix of length j of a packed k-mer is
+// packed >> (5 * (k - j)).
+// k-mers of up to 25 residues are packed the same way into a WidePackedKmer.
+const int KMER_SYMBOL_BITS = 5;
+const int MAX_PACKED_KMER_SIZE = 12;
+const int MAX_WIDE_PACKED_KMER_SIZE = 25;
+
+using WidePackedKmer = unsigned __int128;
+
+// values never produced by packing (bits above 60, or 125, are always clear)
+const uint64_t EMPTY_PACKED_KMER = ~0ULL;
+const WidePackedKmer EMPTY_WIDE_PACKED_KMER = ~WidePackedKmer(0);
+
+inline int encodeResidue(char residue) {
+    if (residue >= 'A' && residue <= 'Z')
+        return residue - 'A' + 2;
+    if (residue == '.')
+        return 1;
+    return -1;
+}
+
+inline char decodeResidue(int code) {
+    return code == 1 ? '.' : static_cast<char>('A' + code - 2);
+}
+
+// Packs kmer (at most MAX_PACKED_KMER_SIZE residues into a uint64_t, or
+// MAX_WIDE_PACKED_KMER_SIZE into a WidePackedKmer). Returns false if it
+// contains a character outside the alphabet.
+template <typename Packed>
+inline bool encodeKmer(std::string_view kmer, Packed &packed) {
+    packed = 0;
+    for (char residue : kmer) {
+        int code = encodeResidue(residue);
+        if (code < 0)
+            return false;
+        packed = (packed << KMER_SYMBOL_BITS) | code;
+    }
+    return true;
+}
+
+template <typename Packed>
+inline std::string decodeKmer(Packed packed, int size) {
+    std::string kmer(size, ' ');
+    for (int i = size - 1; i >= 0; --i, packed >>= KMER_SYMBOL_BITS)
+        kmer[i] = decodeResidue(packed & ((1 << KMER_SYMBOL_BITS) - 1));
+    return kmer;
+}
+
+// Conversions for the key types of the counting tables: packed k-mers for
+// sizes up to MAX_WIDE_PACKED_KMER_SIZE, and plain strings above that.
+inline bool makeKey(std::string_view kmer, uint64_t &key) { return encodeKmer(kmer, key); }
+inline bool makeKey(std::string_view kmer, WidePackedKmer &key) { return encodeKmer(kmer, key); }
+inline bool makeKey(std::string_view kmer, std::string &key) { key.assign(kmer); return true; }
+
+inline std::string keyToString(uint64_t key, int size) { return decodeKmer(key, size); }
+inline std::string keyToString(WidePackedKmer key, int size) { return decodeKmer(key, size); }
+inline const std::string &keyToString(const std::string &key, int) { return key; }
+
+#endif // KMERCODEC_H
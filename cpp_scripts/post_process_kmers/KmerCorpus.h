@@ -0,0 +1,230 @@
+#ifndef KMERCORPUS_H
+#define KMERCORPUS_H
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Append-only store of the proximity k-mers of all PDBs (written by
+// kmers/kmer_corpus.py), replacing one .kmers file per PDB.
+//
+// <path>: 16-byte header (magic "KMERCORP", uint32 version, uint32 reserved),
+//     then the k-mers of each PDB, one per line, as in a .kmers file.
+// <path>.idx: text index; a "KMERCORP <version>" line, then one line
+//     "<pdb id> <offset> <length in bytes> <k-mer count>" per PDB. A PDB that
+//     was added more than once is represented by its last entry.
+const char KMER_CORPUS_MAGIC[8] = {'K', 'M', 'E', 'R', 'C', 'O', 'R', 'P'};
+const uint32_t KMER_CORPUS_VERSION = 1;
+const size_t KMER_CORPUS_HEADER_SIZE = 16;
+
+class KmerCorpus {
+public:
+    struct Entry {
+        std::string pdbId;
+        uint64_t offset;
+        uint64_t length;
+        uint32_t count;
+    };
+
+    KmerCorpus() = default;
+    KmerCorpus(const KmerCorpus &) = delete;
+    KmerCorpus &operator=(const KmerCorpus &) = delete;
+    ~KmerCorpus() { close(); }
+
+    // Maps the corpus at path and loads its index. Returns false, with the
+    // reason in error, if either is missing or malformed.
+    bool open(const std::string &path, std::string &error) {
+        close();
+        if (!loadIndex(path + ".idx", error) || !map(path, error)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (data)
+            munmap(const_cast<char *>(data), size);
+        data = nullptr;
+        size = 0;
+        index.clear();
+        sortedEntries.clear();
+    }
+
+    // Hints that the corpus will be read front to back.
+    void adviseSequential() const {
+        if (data)
+            madvise(const_cast<char *>(data), size, MADV_SEQUENTIAL);
+    }
+
+    // bytes of the corpus file, including entries no longer in the index
+    size_t dataSize() const { return size; }
+
+    // all PDBs, in file order
+    const std::vector<Entry> &entries() const { return sortedEntries; }
+
+    // entry of pdbId, or nullptr if it is not in the corpus
+    const Entry *find(const std::string &pdbId) const {
+        auto it = index.find(pdbId);
+        return it == index.end() ? nullptr : &sortedEntries[it->second];
+    }
+
+    // k-mers of an entry, one per line
+    std::string_view kmers(const Entry &entry) const {
+        return std::string_view(data + entry.offset, entry.length);
+    }
+
+private:
+    bool loadIndex(const std::string &indexPath, std::string &error) {
+        std::ifstream in(indexPath);
+        std::string magic;
+        uint32_t version = 0;
+        if (!(in >> magic >> version) || magic != std::string(KMER_CORPUS_MAGIC, sizeof(KMER_CORPUS_MAGIC))
+            || version != KMER_CORPUS_VERSION) {
+            error = indexPath + " is not a k-mer corpus index of version " + std::to_string(KMER_CORPUS_VERSION);
+            return false;
+        }
+
+        std::unordered_map<std::string, Entry> latest;
+        Entry entry;
+        while (in >> entry.pdbId >> entry.offset >> entry.length >> entry.count)
+            latest[entry.pdbId] = entry;
+
+        for (auto &[_pdbId, e] : latest)
+            sortedEntries.push_back(std::move(e));
+        std::sort(sortedEntries.begin(), sortedEntries.end(),
+                  [](const Entry &a, const Entry &b) { return a.offset < b.offset; });
+        for (size_t i = 0; i < sortedEntries.size(); ++i)
+            index[sortedEntries[i].pdbId] = i;
+        return true;
+    }
+
+    bool map(const std::string &path, std::string &error) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "Could not open " + path;
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= KMER_CORPUS_HEADER_SIZE) {
+            size = info.st_size;
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            data = mapped == MAP_FAILED ? nullptr : static_cast<const char *>(mapped);
+        }
+        ::close(fd);
+
+        uint32_t version = 0;
+        if (data)
+            std::memcpy(&version, data + sizeof(KMER_CORPUS_MAGIC), sizeof(version));
+        if (!data || std::memcmp(data, KMER_CORPUS_MAGIC, sizeof(KMER_CORPUS_MAGIC)) != 0
+            || version != KMER_CORPUS_VERSION) {
+            error = path + " is not a k-mer corpus of version " + std::to_string(KMER_CORPUS_VERSION);
+            return false;
+        }
+
+        for (const auto &e : sortedEntries) {
+            if (e.offset < KMER_CORPUS_HEADER_SIZE || e.offset + e.length > size) {
+                error = path + " is shorter than its index (entry " + e.pdbId + ")";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const char *data = nullptr;
+    size_t size = 0;
+    std::vector<Entry> sortedEntries;
+    std::unordered_map<std::string, size_t> index; // pdb id -> position in sortedEntries
+};
+
+// Appends entries to a corpus, like KmerCorpusWriter in kmers/kmer_corpus.py.
+// Index lines are written after the data they point to is flushed, so an
+// interrupted run leaves a readable corpus.
+class KmerCorpusWriter {
+public:
+    ~KmerCorpusWriter() { close(); }
+
+    // Opens the corpus at path for appending, creating it if it does not
+    // exist. Returns false, with the reason in error, if it cannot be written
+    // or is not a corpus of this version.
+    bool open(const std::string &path, std::string &error) {
+        std::ifstream existing(path, std::ios::binary);
+        char header[KMER_CORPUS_HEADER_SIZE] = {};
+        bool append = existing.read(header, sizeof(header)).gcount() > 0;
+        uint32_t version = 0;
+        std::memcpy(&version, header + sizeof(KMER_CORPUS_MAGIC), sizeof(version));
+        if (append && (existing.gcount() != sizeof(header)
+                       || std::memcmp(header, KMER_CORPUS_MAGIC, sizeof(KMER_CORPUS_MAGIC)) != 0
+                       || version != KMER_CORPUS_VERSION)) {
+            error = path + " is not a k-mer corpus of version " + std::to_string(KMER_CORPUS_VERSION);
+            return false;
+        }
+
+        data.open(path, std::ios::binary | std::ios::app);
+        std::ifstream existingIndex(path + ".idx");
+        bool newIndex = existingIndex.peek() == std::ifstream::traits_type::eof();
+        index.open(path + ".idx", std::ios::app);
+        if (!data || !index) {
+            error = "Could not open " + path + " for writing";
+            return false;
+        }
+
+        if (!append) {
+            uint32_t header[2] = {KMER_CORPUS_VERSION, 0};
+            data.write(KMER_CORPUS_MAGIC, sizeof(KMER_CORPUS_MAGIC));
+            data.write(reinterpret_cast<const char *>(header), sizeof(header));
+        }
+        if (newIndex)
+            index << std::string(KMER_CORPUS_MAGIC, sizeof(KMER_CORPUS_MAGIC)) << ' ' << KMER_CORPUS_VERSION << '\n';
+        offset = data.tellp();
+        return true;
+    }
+
+    // adds the k-mers of pdbId, one per line
+    void add(const std::string &pdbId, std::string_view kmers, uint32_t count) {
+        data.write(kmers.data(), kmers.size());
+        pending += pdbId + ' ' + std::to_string(offset) + ' ' + std::to_string(kmers.size()) + ' '
+            + std::to_string(count) + '\n';
+        offset += kmers.size();
+        if (++pendingCount >= 1000)
+            flush();
+    }
+
+    void flush() {
+        data.flush();
+        index << pending;
+        index.flush();
+        pending.clear();
+        pendingCount = 0;
+    }
+
+    // false if anything could not be written
+    bool close() {
+        if (!data.is_open())
+            return true;
+        flush();
+        bool written = data && index;
+        data.close();
+        index.close();
+        return written;
+    }
+
+private:
+    std::ofstream data, index;
+    uint64_t offset = 0;
+    std::string pending; // index lines of entries whose data may not be flushed yet
+    size_t pendingCount = 0;
+};
+
+#endif // KMERCORPUS_H
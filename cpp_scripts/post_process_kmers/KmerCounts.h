@@ -0,0 +1,411 @@
+#ifndef KMERCOUNTS_H
+#define KMERCOUNTS_H
+
+#include <cstdint>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "CountState.h"
+#include "HeavyHitters.h"
+#include "KmerCodec.h"
+#include "KmerTable.h"
+#include "Parallel.h"
+#include "SpillRuns.h"
+
+// Counting of proximity k-mers, shared by post_process_kmers and
+// kmer_pipeline: every thread counts into its own KmerCounts, and writeSizes
+// merges them into one table per k-mer size, most frequent first.
+
+// options of a count, from the command line
+struct CountOptions {
+    int min_kmer_size = 12;
+    int max_kmer_size = 12;
+    std::string output_prefix = "kmers_k"; // for a range of sizes
+    size_t top_kmers = 0; // 0: print all k-mers
+    bool approximate = false;
+    SketchParameters sketch_parameters;
+};
+
+// One table per k-mer size in [first, last()], for one key type. The table
+// of a size is replaced by a HeavyHitterSketch once it is sketched.
+template <typename Key>
+struct SizeTables {
+    int first;
+    std::vector<PartitionedKmerTable<Key>> tables;
+    std::vector<std::unique_ptr<HeavyHitterSketch<Key>>> sketches;
+    SketchParameters sketch_parameters;
+
+    SizeTables(int first, int last, const SketchParameters& sketch_parameters)
+        : first(first), tables(std::max(0, last - first + 1)), sketches(tables.size()),
+          sketch_parameters(sketch_parameters) {}
+
+    int last() const { return first + static_cast<int>(tables.size()) - 1; }
+    bool contains(int size) const { return size >= first && size <= last(); }
+
+    // count is only ever other than 1 without sketches (--state)
+    void add(int size, const Key& key, uint32_t count = 1) {
+        size_t i = size - first;
+        if(sketches[i]) {
+            sketches[i]->add(key);
+        } else {
+            tables[i].add(key, count);
+        }
+    }
+
+    // moves the counts of size index i from its table into a sketch
+    void sketch(size_t i) {
+        if(sketches[i]) {
+            return;
+        }
+        sketches[i] = std::make_unique<HeavyHitterSketch<Key>>(sketch_parameters);
+        for(size_t p = 0; p < PartitionedKmerTable<Key>::PARTITION_COUNT; ++p) {
+            sketches[i]->add(tables[i].partition(p));
+        }
+        tables[i] = PartitionedKmerTable<Key>();
+    }
+
+    size_t memoryBytes() const {
+        size_t total = 0;
+        for(size_t i = 0; i < tables.size(); ++i) {
+            total += sketches[i] ? sketches[i]->memoryBytes() : tables[i].memoryBytes();
+        }
+        return total;
+    }
+};
+
+// Counts of one thread for all sizes in [min_kmer_size, max_kmer_size]:
+// packed keys up to MAX_WIDE_PACKED_KMER_SIZE, strings above.
+struct KmerCounts {
+    SizeTables<uint64_t> packed;
+    SizeTables<WidePackedKmer> widePacked;
+    SizeTables<std::string> strings;
+    int max_kmer_size;
+
+    explicit KmerCounts(const CountOptions& options)
+        : packed(options.min_kmer_size, std::min(options.max_kmer_size, MAX_PACKED_KMER_SIZE),
+                 options.sketch_parameters),
+          widePacked(std::max(options.min_kmer_size, MAX_PACKED_KMER_SIZE + 1),
+                     std::min(options.max_kmer_size, MAX_WIDE_PACKED_KMER_SIZE), options.sketch_parameters),
+          strings(std::max(options.min_kmer_size, MAX_WIDE_PACKED_KMER_SIZE + 1), options.max_kmer_size,
+                  options.sketch_parameters),
+          max_kmer_size(options.max_kmer_size) {
+        if(options.approximate) {
+            startSketching();
+        }
+    }
+
+    bool sketching = false;
+
+    // switches every size to bounded-memory counting
+    void startSketching() {
+        for(size_t i = 0; i < packed.tables.size(); ++i) packed.sketch(i);
+        for(size_t i = 0; i < widePacked.tables.size(); ++i) widePacked.sketch(i);
+        for(size_t i = 0; i < strings.tables.size(); ++i) strings.sketch(i);
+        sketching = true;
+    }
+
+    size_t memoryBytes() const {
+        return packed.memoryBytes() + widePacked.memoryBytes() + strings.memoryBytes();
+    }
+};
+
+// Counts the prefixes of every line of text, of all sizes at once, count
+// times each. Packed prefixes are extended one residue at a time, so each size
+// reuses the shorter one.
+inline void countKmerLines(std::string_view text, KmerCounts& kmers, uint32_t count = 1) {
+    std::string key;
+    const int packed_max = std::min(kmers.max_kmer_size, MAX_WIDE_PACKED_KMER_SIZE);
+
+    while(!text.empty()) {
+        size_t line_end = std::min(text.find('\n'), text.size());
+        std::string_view line = text.substr(0, line_end);
+        text.remove_prefix(std::min(line_end + 1, text.size()));
+        const int length = static_cast<int>(line.length());
+
+        WidePackedKmer packed = 0;
+        for(int size = 1; size <= std::min(packed_max, length); ++size) {
+            int code = encodeResidue(line[size - 1]);
+            if(code < 0) {
+                break;
+            }
+            packed = (packed << KMER_SYMBOL_BITS) | code;
+            if(kmers.packed.contains(size)) {
+                kmers.packed.add(size, static_cast<uint64_t>(packed), count);
+            } else if(kmers.widePacked.contains(size)) {
+                kmers.widePacked.add(size, packed, count);
+            }
+        }
+
+        for(int size = kmers.strings.first; size <= std::min(kmers.strings.last(), length); ++size) {
+            key.assign(line.substr(0, size));
+            kmers.strings.add(size, key, count);
+        }
+    }
+}
+
+// Merges the tables of all threads for one k-mer size and writes the
+// k-mers to out, most frequent first, and all of them to state, if given.
+//
+// Partition p of every thread holds the same k-mers, so the partitions are
+// merged and sorted in parallel, and the sorted partitions then merged
+// pairwise into the output order.
+template <typename Key>
+void writeKmers(std::vector<PartitionedKmerTable<Key>>& thread_kmers, int size, size_t top_kmers,
+                std::ostream& out, unsigned int thread_count, CountStateWriter* state) {
+    using Table = PartitionedKmerTable<Key>;
+    using Entry = std::pair<Key, uint32_t>;
+
+    auto by_frequency = [](const Entry& a, const Entry& b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    };
+
+    std::vector<std::vector<Entry>> sorted_partitions(Table::PARTITION_COUNT);
+    std::vector<size_t> table_bytes(Table::PARTITION_COUNT);
+
+    parallelFor(Table::PARTITION_COUNT, thread_count, [&](size_t p, unsigned int) {
+        KmerTable<Key> merged = std::move(thread_kmers[0].partition(p));
+        for(size_t t = 1; t < thread_kmers.size(); ++t) {
+            merged.merge(thread_kmers[t].partition(p));
+            thread_kmers[t].partition(p) = KmerTable<Key>(0);
+        }
+        table_bytes[p] = merged.memoryBytes();
+
+        // k-mers of PDBs that were subtracted (--state) may be left at 0
+        auto& sorted = sorted_partitions[p];
+        sorted = merged.entries();
+        sorted.erase(std::remove_if(sorted.begin(), sorted.end(), [](const Entry& e) { return e.second == 0; }),
+                     sorted.end());
+
+        // with --top, only the top N of a partition can make the output
+        if(top_kmers && !state && sorted.size() > top_kmers) {
+            std::partial_sort(sorted.begin(), sorted.begin() + top_kmers, sorted.end(), by_frequency);
+            sorted.resize(top_kmers);
+            sorted.shrink_to_fit();
+        } else {
+            std::sort(sorted.begin(), sorted.end(), by_frequency);
+        }
+    });
+
+    // concatenate the sorted partitions and merge neighbouring runs pairwise,
+    // in parallel, until one sorted run is left
+    std::vector<size_t> run_starts{0};
+    for(const auto& partition : sorted_partitions) {
+        run_starts.push_back(run_starts.back() + partition.size());
+    }
+    std::vector<Entry> sorted_kmers;
+    sorted_kmers.reserve(run_starts.back());
+    for(auto& partition : sorted_partitions) {
+        std::move(partition.begin(), partition.end(), std::back_inserter(sorted_kmers));
+        std::vector<Entry>().swap(partition);
+    }
+
+    while(run_starts.size() > 2) {
+        size_t runs = run_starts.size() - 1;
+        parallelFor(runs / 2, thread_count, [&](size_t pair, unsigned int) {
+            auto begin = sorted_kmers.begin();
+            std::inplace_merge(begin + run_starts[2 * pair], begin + run_starts[2 * pair + 1],
+                               begin + run_starts[2 * pair + 2], by_frequency);
+        });
+
+        std::vector<size_t> merged_starts;
+        for(size_t i = 0; i < run_starts.size(); i += 2) {
+            merged_starts.push_back(run_starts[i]);
+        }
+        if(runs % 2 == 1) {
+            merged_starts.push_back(run_starts.back());
+        }
+        run_starts.swap(merged_starts);
+    }
+
+    size_t total_bytes = 0;
+    for(size_t bytes : table_bytes) {
+        total_bytes += bytes;
+    }
+    std::cerr << "Counted " << sorted_kmers.size() << " distinct " << size << "-mers ("
+              << std::fixed << std::setprecision(2) << total_bytes / 1e6 << " MB table)" << std::endl;
+
+    // (--state keeps packed sizes only)
+    if constexpr(!std::is_same_v<Key, std::string>) {
+        if(state) {
+            state->writeTable(sorted_kmers);
+        }
+    }
+    if(top_kmers && sorted_kmers.size() > top_kmers) {
+        sorted_kmers.resize(top_kmers);
+    }
+    for(const auto& [kmer, freq] : sorted_kmers) {
+        out << keyToString(kmer, size) << " " << freq << '\n';
+    }
+    out.flush();
+}
+
+// Merges the sketches of all threads for one k-mer size and writes the
+// approximate top k-mers to out, as "kmer count lower upper", where the true
+// count lies in [lower, upper] with probability 1 - delta.
+template <typename Key>
+void writeHeavyHitters(const std::vector<HeavyHitterSketch<Key>*>& thread_sketches, int size,
+                       const SketchParameters& sketch_parameters, std::ostream& out) {
+    std::vector<HeavyHitter<Key>> top = HeavyHitterSketch<Key>::merge(thread_sketches);
+
+    std::cerr << std::defaultfloat << "Approximate top " << top.size() << " " << size << "-mers (epsilon "
+              << sketch_parameters.epsilon << ", delta " << sketch_parameters.delta << ")" << std::endl;
+
+    for(const auto& hitter : top) {
+        out << keyToString(hitter.key, size) << " " << hitter.count << " "
+            << hitter.lower << " " << hitter.upper << '\n';
+    }
+    out.flush();
+}
+
+// Opens the output of k-mer size: stdout for a single size, and
+// <output_prefix><size>.txt for a range. Returns nullptr if it can not be
+// written.
+inline std::ostream* openSizeOutput(const CountOptions& options, int size, std::ofstream& file) {
+    if(options.min_kmer_size == options.max_kmer_size) {
+        return &std::cout;
+    }
+    std::string output_path = options.output_prefix + std::to_string(size) + ".txt";
+    file.open(output_path);
+    if(!file) {
+        std::cerr << "Could not write " << output_path << std::endl;
+        return nullptr;
+    }
+    return &file;
+}
+
+// Collects the tables of one key type from every thread and writes them,
+// to stdout for a single size, or to <output_prefix><size>.txt for a range,
+// and to state, if given.
+template <typename Key>
+int writeSizes(std::vector<KmerCounts>& thread_counts, SizeTables<Key> KmerCounts::*sizes,
+               const CountOptions& options, unsigned int thread_count, CountStateWriter* state) {
+    const SizeTables<Key>& first_thread = thread_counts[0].*sizes;
+    for(size_t i = 0; i < first_thread.tables.size(); ++i) {
+        int size = first_thread.first + i;
+
+        std::ofstream file;
+        std::ostream* output = openSizeOutput(options, size, file);
+        if(!output) {
+            return 1;
+        }
+        std::ostream& out = *output;
+
+        // if any thread ran out of memory and sketched, all of them have to
+        bool sketched = false;
+        for(auto& counts : thread_counts) {
+            sketched |= static_cast<bool>((counts.*sizes).sketches[i]);
+        }
+
+        if(sketched) {
+            std::vector<HeavyHitterSketch<Key>*> thread_sketches;
+            for(auto& counts : thread_counts) {
+                (counts.*sizes).sketch(i);
+                thread_sketches.push_back((counts.*sizes).sketches[i].get());
+            }
+            writeHeavyHitters(thread_sketches, size, options.sketch_parameters, out);
+        } else {
+            std::vector<PartitionedKmerTable<Key>> thread_kmers;
+            for(auto& counts : thread_counts) {
+                thread_kmers.push_back(std::move((counts.*sizes).tables[i]));
+            }
+            writeKmers(thread_kmers, size, options.top_kmers, out, thread_count, state);
+        }
+    }
+    return 0;
+}
+
+// Runs of counts spilled to disk (--memory-budget, see SpillRuns.h), per
+// k-mer size, shared by all threads.
+struct KmerSpill {
+    SpillDirectory directory;
+    std::mutex mutex;
+    std::vector<std::vector<std::string>> packed, widePacked, strings; // runs per size index
+    size_t spills = 0;
+
+    bool empty() const { return spills == 0; }
+};
+
+template <typename Key>
+bool spillSizes(SizeTables<Key>& sizes, std::vector<std::vector<std::string>> KmerSpill::*runs, KmerSpill& spill) {
+    for(size_t i = 0; i < sizes.tables.size(); ++i) {
+        if(sizes.tables[i].size() == 0) {
+            continue;
+        }
+        std::string path = spill.directory.newRunPath();
+        if(!spillTable(sizes.tables[i], path)) {
+            std::cerr << "Could not write " << path << std::endl;
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(spill.mutex);
+        (spill.*runs).resize(sizes.tables.size());
+        (spill.*runs)[i].push_back(path);
+    }
+    return true;
+}
+
+// Spills the tables of counts to runs, and empties them. Returns false if a
+// run could not be written.
+inline bool spillCounts(KmerCounts& counts, KmerSpill& spill) {
+    bool spilled = spillSizes(counts.packed, &KmerSpill::packed, spill)
+        && spillSizes(counts.widePacked, &KmerSpill::widePacked, spill)
+        && spillSizes(counts.strings, &KmerSpill::strings, spill);
+    std::lock_guard<std::mutex> lock(spill.mutex);
+    spill.spills++;
+    return spilled;
+}
+
+// Merges the spilled runs of one key type, one size at a time, and writes
+// them like writeSizes, sorting by frequency within memory_bytes.
+template <typename Key>
+int writeSpilledSizes(KmerSpill& spill, const SizeTables<Key>& sizes,
+                      std::vector<std::vector<std::string>> KmerSpill::*runs, const CountOptions& options,
+                      size_t memory_bytes) {
+    auto& size_runs = spill.*runs;
+    size_runs.resize(sizes.tables.size());
+    for(size_t i = 0; i < sizes.tables.size(); ++i) {
+        int size = sizes.first + i;
+        std::ofstream file;
+        std::ostream* out = openSizeOutput(options, size, file);
+        if(!out) {
+            return 1;
+        }
+
+        size_t run_count = size_runs[i].size();
+        size_t distinct_kmers = 0;
+        if(!writeRunKmers<Key>(std::move(size_runs[i]), size, options.top_kmers, memory_bytes, spill.directory,
+                               *out, distinct_kmers)) {
+            std::cerr << "Could not read or write the k-mer runs of size " << size << std::endl;
+            return 1;
+        }
+        std::cerr << "Counted " << distinct_kmers << " distinct " << size << "-mers (merged from "
+                  << run_count << " runs)" << std::endl;
+    }
+    return 0;
+}
+
+// Parses a k-mer size "K" or size range "MIN-MAX" into min_kmer_size and
+// max_kmer_size of options.
+inline bool parseKmerSizes(const std::string& value, CountOptions& options) {
+    int& min_kmer_size = options.min_kmer_size;
+    int& max_kmer_size = options.max_kmer_size;
+    size_t dash = value.find('-');
+    try {
+        min_kmer_size = std::stoi(value.substr(0, dash));
+        max_kmer_size = dash == std::string::npos ? min_kmer_size : std::stoi(value.substr(dash + 1));
+    } catch(const std::exception&) {
+        return false;
+    }
+    return min_kmer_size >= 1 && min_kmer_size <= max_kmer_size;
+}
+
+#endif // KMERCOUNTS_H
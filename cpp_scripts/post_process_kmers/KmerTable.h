@@ -0,0 +1,189 @@
+#ifndef KMERTABLE_H
+#define KMERTABLE_H
+
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "KmerCodec.h"
+
+// Empty-slot marker and hash for each key type of KmerTable.
+template <typename Key>
+struct KmerKeyTraits;
+
+template <>
+struct KmerKeyTraits<uint64_t> {
+    static uint64_t empty() { return EMPTY_PACKED_KMER; }
+    static bool isEmpty(uint64_t key) { return key == EMPTY_PACKED_KMER; }
+
+    // murmur3 finalizer; packed k-mers differ mostly in their low bits
+    static uint64_t hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+};
+
+template <>
+struct KmerKeyTraits<WidePackedKmer> {
+    static WidePackedKmer empty() { return EMPTY_WIDE_PACKED_KMER; }
+    static bool isEmpty(WidePackedKmer key) { return key == EMPTY_WIDE_PACKED_KMER; }
+
+    static uint64_t hash(WidePackedKmer key) {
+        uint64_t high = KmerKeyTraits<uint64_t>::hash(static_cast<uint64_t>(key >> 64));
+        return KmerKeyTraits<uint64_t>::hash(static_cast<uint64_t>(key) ^ high);
+    }
+};
+
+template <>
+struct KmerKeyTraits<std::string> {
+    static std::string empty() { return std::string(); }
+    static bool isEmpty(const std::string &key) { return key.empty(); }
+    static uint64_t hash(const std::string &key) { return std::hash<std::string>()(key); }
+};
+
+// Open-addressing hash table counting k-mers, with linear probing. Keys and
+// counts are kept in separate flat arrays, so a packed k-mer costs 12 bytes
+// per slot, instead of a heap string plus a node for std::unordered_map.
+template <typename Key>
+class KmerTable {
+public:
+    using Traits = KmerKeyTraits<Key>;
+
+    explicit KmerTable(size_t initialCapacity = 1024) {
+        size_t capacity = 16;
+        while (capacity < initialCapacity)
+            capacity *= 2;
+        keys.assign(capacity, Traits::empty());
+        counts.assign(capacity, 0);
+    }
+
+    void add(const Key &key, uint32_t count = 1) {
+        addHashed(key, Traits::hash(key), count);
+    }
+
+    // add() for callers that already computed Traits::hash(key)
+    void addHashed(const Key &key, uint64_t hash, uint32_t count = 1) {
+        if ((filled + 1) * 10 > keys.size() * 7) // keep load factor below 0.7
+            grow();
+
+        size_t slot = findSlot(key, hash);
+        if (Traits::isEmpty(keys[slot])) {
+            keys[slot] = key;
+            filled++;
+        }
+        counts[slot] += count;
+    }
+
+    // count of key, or 0 if it is not in the table
+    uint32_t count(const Key &key) const {
+        size_t slot = findSlot(key, Traits::hash(key));
+        return Traits::isEmpty(keys[slot]) ? 0 : counts[slot];
+    }
+
+    size_t size() const { return filled; }
+    size_t capacity() const { return keys.size(); }
+
+    // bytes held by the slot arrays (not including heap memory of string keys)
+    size_t memoryBytes() const { return keys.size() * (sizeof(Key) + sizeof(uint32_t)); }
+
+    // adds all counts of other to this table
+    void merge(const KmerTable &other) {
+        other.forEach([&](const Key &key, uint32_t count) { add(key, count); });
+    }
+
+    // calls fn(key, count) for every k-mer in the table
+    template <typename Function>
+    void forEach(Function fn) const {
+        for (size_t slot = 0; slot < keys.size(); ++slot) {
+            if (!Traits::isEmpty(keys[slot]))
+                fn(keys[slot], counts[slot]);
+        }
+    }
+
+    std::vector<std::pair<Key, uint32_t>> entries() const {
+        std::vector<std::pair<Key, uint32_t>> result;
+        result.reserve(filled);
+        forEach([&](const Key &key, uint32_t count) { result.emplace_back(key, count); });
+        return result;
+    }
+
+    void clear() {
+        std::fill(keys.begin(), keys.end(), Traits::empty());
+        std::fill(counts.begin(), counts.end(), 0);
+        filled = 0;
+    }
+
+private:
+    size_t findSlot(const Key &key, uint64_t hash) const {
+        size_t mask = keys.size() - 1;
+        size_t slot = hash & mask;
+        while (!Traits::isEmpty(keys[slot]) && !(keys[slot] == key))
+            slot = (slot + 1) & mask;
+        return slot;
+    }
+
+    void grow() {
+        std::vector<Key> oldKeys(keys.size() * 2, Traits::empty());
+        std::vector<uint32_t> oldCounts(counts.size() * 2, 0);
+        oldKeys.swap(keys);
+        oldCounts.swap(counts);
+
+        for (size_t slot = 0; slot < oldKeys.size(); ++slot) {
+            if (Traits::isEmpty(oldKeys[slot]))
+                continue;
+            size_t newSlot = findSlot(oldKeys[slot], Traits::hash(oldKeys[slot]));
+            keys[newSlot] = std::move(oldKeys[slot]);
+            counts[newSlot] = oldCounts[slot];
+        }
+    }
+
+    std::vector<Key> keys;
+    std::vector<uint32_t> counts;
+    size_t filled = 0;
+};
+
+// KmerTable split into 2^PARTITION_BITS tables by the top bits of the key
+// hash. Tables of different threads can then be merged partition by
+// partition, in parallel, without locking.
+template <typename Key>
+class PartitionedKmerTable {
+public:
+    static const int PARTITION_BITS = 6;
+    static const size_t PARTITION_COUNT = size_t(1) << PARTITION_BITS;
+
+    PartitionedKmerTable() : partitions(PARTITION_COUNT, KmerTable<Key>(64)) {}
+
+    void add(const Key &key, uint32_t count = 1) {
+        uint64_t hash = KmerKeyTraits<Key>::hash(key);
+        partitions[hash >> (64 - PARTITION_BITS)].addHashed(key, hash, count);
+    }
+
+    KmerTable<Key> &partition(size_t i) { return partitions[i]; }
+    const KmerTable<Key> &partition(size_t i) const { return partitions[i]; }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const auto &table : partitions)
+            total += table.size();
+        return total;
+    }
+
+    size_t memoryBytes() const {
+        size_t total = 0;
+        for (const auto &table : partitions)
+            total += table.memoryBytes();
+        return total;
+    }
+
+private:
+    std::vector<KmerTable<Key>> partitions;
+};
+
+#endif // KMERTABLE_H
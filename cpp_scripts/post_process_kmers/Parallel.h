@@ -0,0 +1,38 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Calls fn(index, threadIndex) for every index in [0, count) on threadCount
+// threads. Indices are handed out one at a time, so uneven work balances out.
+template <typename Function>
+void parallelFor(size_t count, unsigned int threadCount, Function fn) {
+    threadCount = std::max(1u, threadCount);
+    std::atomic<size_t> next{0};
+
+    auto work = [&](unsigned int threadIndex) {
+        for (size_t i = next++; i < count; i = next++)
+            fn(i, threadIndex);
+    };
+
+    if (threadCount == 1) {
+        work(0);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < threadCount; ++t)
+        threads.emplace_back(work, t);
+    for (auto &thread : threads)
+        thread.join();
+}
+
+// thread count for a -j option; 0 means all cores
+inline unsigned int resolveThreadCount(unsigned int requested) {
+    return requested ? requested : std::max(1u, std::thread::hardware_concurrency());
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,538 @@
+#ifndef SPILLRUNS_H
+#define SPILLRUNS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "KmerCodec.h"
+#include "KmerTable.h"
+
+// Out-of-core counting (post_process_kmers --memory-budget): once the tables
+// of a thread outgrow its share of the budget, each of them is sorted by key
+// and spilled to a run file, and the tables start over empty. The runs of a
+// size are then merged k ways, summing the counts of equal k-mers, and the
+// merged counts sorted by frequency, in memory if they fit the budget, and
+// through runs sorted by frequency otherwise, which are merged k ways again
+// into the output. Only the runs, not the counts, have to fit on disk.
+//
+// A run is a sequence of entries, each a key and a varint count. Keys are
+// compressed: packed keys as the varint difference to the previous key in
+// runs sorted by key (and as varints in others), string keys as the length
+// of the prefix shared with the previous key, and the rest of the key.
+
+namespace spill_runs {
+
+inline void appendVarint(std::string &out, unsigned __int128 value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+inline void appendKey(std::string &out, uint64_t key, uint64_t previous) { appendVarint(out, key - previous); }
+inline void appendKey(std::string &out, WidePackedKmer key, WidePackedKmer previous) {
+    appendVarint(out, key - previous);
+}
+inline void appendKey(std::string &out, const std::string &key, const std::string &previous) {
+    size_t shared = 0;
+    while (shared < key.size() && shared < previous.size() && key[shared] == previous[shared])
+        ++shared;
+    appendVarint(out, shared);
+    appendVarint(out, key.size() - shared);
+    out.append(key, shared, std::string::npos);
+}
+
+} // namespace spill_runs
+
+// Writes a run front to back, through a buffer.
+template <typename Key>
+class RunWriter {
+public:
+    // deltaKeys: whether the entries are written in key order, so that keys
+    // can be stored as differences
+    RunWriter(const std::string &path, bool deltaKeys) : path(path), deltaKeys(deltaKeys) {
+        file = std::fopen(path.c_str(), "wb");
+        failed = !file;
+    }
+
+    ~RunWriter() { close(); }
+
+    RunWriter(const RunWriter &) = delete;
+    RunWriter &operator=(const RunWriter &) = delete;
+
+    void add(const Key &key, uint32_t count) {
+        spill_runs::appendKey(buffer, key, previous);
+        spill_runs::appendVarint(buffer, count);
+        if (deltaKeys)
+            previous = key;
+        if (buffer.size() >= BUFFER_SIZE)
+            flush();
+    }
+
+    // Returns false if the run could not be written completely.
+    bool close() {
+        if (file) {
+            flush();
+            failed = std::fclose(file) != 0 || failed;
+            file = nullptr;
+        }
+        return !failed;
+    }
+
+    const std::string &filePath() const { return path; }
+
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    void flush() {
+        if (file && !buffer.empty() && std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+            failed = true;
+        buffer.clear();
+    }
+
+    std::string path;
+    bool deltaKeys;
+    std::FILE *file = nullptr;
+    std::string buffer;
+    Key previous{};
+    bool failed = false;
+};
+
+// default and smallest size of the buffer of a RunReader
+const size_t RUN_READ_BUFFER_SIZE = 1 << 20;
+const size_t MIN_RUN_READ_BUFFER_SIZE = 1 << 14;
+
+// Reads a run written by RunWriter, through a buffer of bufferSize bytes.
+template <typename Key>
+class RunReader {
+public:
+    RunReader(const std::string &path, bool deltaKeys, size_t bufferSize = RUN_READ_BUFFER_SIZE)
+        : deltaKeys(deltaKeys), buffer(std::max(bufferSize, MIN_RUN_READ_BUFFER_SIZE)) {
+        file = std::fopen(path.c_str(), "rb");
+        failed = !file;
+    }
+
+    ~RunReader() {
+        if (file)
+            std::fclose(file);
+    }
+
+    RunReader(const RunReader &) = delete;
+    RunReader &operator=(const RunReader &) = delete;
+
+    // Reads the next entry; false at the end of the run, or if it is
+    // truncated or unreadable (see hasError).
+    bool next(Key &key, uint32_t &count) {
+        if (failed || !more())
+            return false;
+        if (!readKey(key)) {
+            failed = true;
+            return false;
+        }
+        unsigned __int128 value;
+        if (!readVarint(value)) {
+            failed = true;
+            return false;
+        }
+        count = static_cast<uint32_t>(value);
+        return true;
+    }
+
+    bool hasError() const { return failed; }
+
+private:
+    // whether there are bytes left, refilling the buffer if needed
+    bool more() {
+        if (position < filled)
+            return true;
+        filled = file ? std::fread(buffer.data(), 1, buffer.size(), file) : 0;
+        position = 0;
+        if (filled == 0 && file && std::ferror(file))
+            failed = true;
+        return filled > 0;
+    }
+
+    bool readByte(unsigned char &byte) {
+        if (!more())
+            return false;
+        byte = static_cast<unsigned char>(buffer[position++]);
+        return true;
+    }
+
+    bool readVarint(unsigned __int128 &value) {
+        value = 0;
+        unsigned char byte;
+        for (int shift = 0; shift < 128; shift += 7) {
+            if (!readByte(byte))
+                return false;
+            value |= static_cast<unsigned __int128>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool readKey(uint64_t &key) {
+        unsigned __int128 value;
+        if (!readVarint(value))
+            return false;
+        key = previous + static_cast<uint64_t>(value);
+        if (deltaKeys)
+            previous = key;
+        return true;
+    }
+
+    bool readKey(WidePackedKmer &key) {
+        unsigned __int128 value;
+        if (!readVarint(value))
+            return false;
+        key = previousWide + value;
+        if (deltaKeys)
+            previousWide = key;
+        return true;
+    }
+
+    bool readKey(std::string &key) {
+        unsigned __int128 shared, rest;
+        if (!readVarint(shared) || !readVarint(rest) || shared > previousString.size())
+            return false;
+        key.assign(previousString, 0, static_cast<size_t>(shared));
+        for (size_t i = 0; i < rest; ++i) {
+            unsigned char byte;
+            if (!readByte(byte))
+                return false;
+            key += static_cast<char>(byte);
+        }
+        if (deltaKeys)
+            previousString = key;
+        return true;
+    }
+
+    bool deltaKeys;
+    std::FILE *file = nullptr;
+    std::vector<char> buffer;
+    size_t position = 0;
+    size_t filled = 0;
+    bool failed = false;
+    uint64_t previous = 0;
+    WidePackedKmer previousWide = 0;
+    std::string previousString;
+};
+
+// Directory for the runs of one count, removed with everything in it when
+// the count is done.
+class SpillDirectory {
+public:
+    SpillDirectory() = default;
+    ~SpillDirectory() {
+        if (!path.empty()) {
+            std::error_code ec;
+            std::filesystem::remove_all(path, ec);
+        }
+    }
+
+    SpillDirectory(const SpillDirectory &) = delete;
+    SpillDirectory &operator=(const SpillDirectory &) = delete;
+
+    // Creates a new directory in parent. Returns false, with the reason in
+    // error, if it cannot.
+    bool create(const std::string &parent, std::string &error) {
+        std::string pattern = (std::filesystem::path(parent) / "kmer_runs.XXXXXX").string();
+        if (!mkdtemp(pattern.data())) {
+            error = "Could not create a directory for k-mer runs in " + parent;
+            return false;
+        }
+        path = pattern;
+        return true;
+    }
+
+    // a path for a new run, unique among all threads
+    std::string newRunPath() {
+        return (std::filesystem::path(path) / (std::to_string(nextRun++) + ".run")).string();
+    }
+
+private:
+    std::string path;
+    std::atomic<size_t> nextRun{0};
+};
+
+// Merges runs that are each sorted by less into one sequence sorted by less,
+// holding one entry and a read buffer of bufferSize bytes per run. memoryRun,
+// if given, is one more run, already in memory and sorted by less, merged
+// after the ones at paths.
+template <typename Key, typename Less>
+class RunMerger {
+public:
+    RunMerger(const std::vector<std::string> &paths, bool deltaKeys, Less less, size_t bufferSize,
+              const std::vector<std::pair<Key, uint32_t>> *memoryRun = nullptr)
+        : memoryRun(memoryRun), heap(HeapOrder{less}) {
+        for (const auto &path : paths)
+            readers.push_back(std::make_unique<RunReader<Key>>(path, deltaKeys, bufferSize));
+        for (size_t i = 0; i < readers.size(); ++i)
+            advance(i);
+        if (memoryRun)
+            advance(readers.size());
+    }
+
+    // Reads the next entry; false once all runs are done (see hasError).
+    bool next(Key &key, uint32_t &count) {
+        if (heap.empty())
+            return false;
+        Head head = heap.top();
+        heap.pop();
+        key = std::move(head.key);
+        count = head.count;
+        advance(head.run);
+        return true;
+    }
+
+    bool hasError() const {
+        for (const auto &reader : readers) {
+            if (reader->hasError())
+                return true;
+        }
+        return false;
+    }
+
+private:
+    struct Head {
+        Key key;
+        uint32_t count;
+        size_t run;
+    };
+
+    // the smallest entry by less on top; ties in run order, for a stable merge
+    struct HeapOrder {
+        Less less;
+        bool operator()(const Head &a, const Head &b) const {
+            if (less(a.key, a.count, b.key, b.count))
+                return false;
+            if (less(b.key, b.count, a.key, a.count))
+                return true;
+            return a.run > b.run;
+        }
+    };
+
+    void advance(size_t run) {
+        if (run == readers.size()) {
+            if (memoryNext < memoryRun->size()) {
+                const auto &[key, count] = (*memoryRun)[memoryNext++];
+                heap.push(Head{key, count, run});
+            }
+            return;
+        }
+        Head head{Key{}, 0, run};
+        if (readers[run]->next(head.key, head.count))
+            heap.push(std::move(head));
+    }
+
+    std::vector<std::unique_ptr<RunReader<Key>>> readers;
+    const std::vector<std::pair<Key, uint32_t>> *memoryRun;
+    size_t memoryNext = 0;
+    std::priority_queue<Head, std::vector<Head>, HeapOrder> heap;
+};
+
+// run orders: by key, and most frequent first (ties by key), as written out
+struct ByKey {
+    template <typename Key>
+    bool operator()(const Key &a, uint32_t, const Key &b, uint32_t) const { return a < b; }
+};
+
+struct ByFrequency {
+    template <typename Key>
+    bool operator()(const Key &a, uint32_t countA, const Key &b, uint32_t countB) const {
+        return countA > countB || (countA == countB && a < b);
+    }
+};
+
+// Sorts the k-mers of table by key, writes them to a run at path, and empties
+// the table. The table is emptied partition by partition as they are
+// collected, so that at most about its own size is held twice. Returns false
+// if the run could not be written.
+template <typename Key>
+bool spillTable(PartitionedKmerTable<Key> &table, const std::string &path) {
+    std::vector<std::pair<Key, uint32_t>> entries;
+    entries.reserve(table.size());
+    for (size_t p = 0; p < PartitionedKmerTable<Key>::PARTITION_COUNT; ++p) {
+        table.partition(p).forEach([&](const Key &key, uint32_t count) { entries.emplace_back(key, count); });
+        table.partition(p) = KmerTable<Key>(64);
+    }
+    std::sort(entries.begin(), entries.end());
+
+    RunWriter<Key> writer(path, true);
+    for (const auto &[key, count] : entries)
+        writer.add(key, count);
+    return writer.close();
+}
+
+// at most this many runs are merged at once, to stay within the limit of
+// open files; more are merged in several passes
+const size_t MAX_MERGED_RUNS = 256;
+
+// Merges runs sorted by less, MAX_MERGED_RUNS at a time, until at most
+// MAX_MERGED_RUNS are left; equal keys are summed if sumKeys (runs sorted by
+// key), reading each run through a buffer of bufferSize bytes. Merged runs
+// are deleted. Returns false if a run could not be read or written.
+template <typename Key, typename Less>
+bool reduceRuns(std::vector<std::string> &runs, SpillDirectory &directory, bool deltaKeys, Less less,
+                bool sumKeys, size_t bufferSize) {
+    while (runs.size() > MAX_MERGED_RUNS) {
+        std::vector<std::string> merged;
+        for (size_t first = 0; first < runs.size(); first += MAX_MERGED_RUNS) {
+            std::vector<std::string> group(runs.begin() + first,
+                                           runs.begin() + std::min(runs.size(), first + MAX_MERGED_RUNS));
+            RunMerger<Key, Less> merger(group, deltaKeys, less, bufferSize);
+            RunWriter<Key> writer(directory.newRunPath(), deltaKeys);
+
+            Key key, pending;
+            uint32_t count, pendingCount = 0;
+            bool hasPending = false;
+            while (merger.next(key, count)) {
+                if (sumKeys && hasPending && key == pending) {
+                    pendingCount += count;
+                    continue;
+                }
+                if (hasPending)
+                    writer.add(pending, pendingCount);
+                pending = std::move(key);
+                pendingCount = count;
+                hasPending = true;
+            }
+            if (hasPending)
+                writer.add(pending, pendingCount);
+
+            if (merger.hasError() || !writer.close())
+                return false;
+            for (const auto &path : group)
+                std::remove(path.c_str());
+            merged.push_back(writer.filePath());
+        }
+        runs.swap(merged);
+    }
+    return true;
+}
+
+// Merges the runs of one k-mer size, sorted by key, and writes the k-mers to
+// out, most frequent first; only the top topKmers, if not 0. The merged
+// counts are sorted in chunks of up to memoryBytes, spilled as runs sorted by
+// frequency unless they all fit in one; the read buffers of a merge take up
+// to another half of memoryBytes. distinctKmers is set to the number of
+// k-mers counted. Runs are deleted. Returns false if a run could not be read
+// or written.
+template <typename Key>
+bool writeRunKmers(std::vector<std::string> runs, int size, size_t topKmers, size_t memoryBytes,
+                   SpillDirectory &directory, std::ostream &out, size_t &distinctKmers) {
+    using Entry = std::pair<Key, uint32_t>;
+    auto byFrequency = [](const Entry &a, const Entry &b) {
+        return ByFrequency()(a.first, a.second, b.first, b.second);
+    };
+    distinctKmers = 0;
+    const size_t bufferSize = memoryBytes / (2 * MAX_MERGED_RUNS);
+
+    if (!reduceRuns<Key>(runs, directory, true, ByKey(), true, bufferSize))
+        return false;
+
+    std::vector<Entry> chunk;
+    std::vector<std::string> frequencyRuns;
+    const size_t entryBytes = sizeof(Entry) + (std::is_same_v<Key, std::string> ? size : 0);
+    const size_t chunkEntries = std::max<size_t>(1, memoryBytes / entryBytes);
+    bool failed = false;
+
+    // with --top, a heap of the top k-mers so far, least frequent on top
+    std::priority_queue<Entry, std::vector<Entry>, decltype(byFrequency)> top(byFrequency);
+
+    auto emit = [&](Entry entry) {
+        if (entry.second == 0)
+            return;
+        distinctKmers++;
+        if (topKmers) {
+            top.push(std::move(entry));
+            if (top.size() > topKmers)
+                top.pop();
+            return;
+        }
+        chunk.push_back(std::move(entry));
+        if (chunk.size() >= chunkEntries) {
+            std::sort(chunk.begin(), chunk.end(), byFrequency);
+            RunWriter<Key> writer(directory.newRunPath(), false);
+            for (const auto &[key, count] : chunk)
+                writer.add(key, count);
+            failed = !writer.close() || failed;
+            frequencyRuns.push_back(writer.filePath());
+            chunk.clear();
+        }
+    };
+
+    Key key;
+    uint32_t count;
+    {
+        // k-mers of PDBs that were subtracted are left at 0, as in writeKmers;
+        // the runs are closed before the frequency merge opens its own
+        RunMerger<Key, ByKey> merger(runs, true, ByKey(), bufferSize);
+        Entry pending;
+        bool hasPending = false;
+        while (merger.next(key, count)) {
+            if (hasPending && key == pending.first) {
+                pending.second += count;
+                continue;
+            }
+            if (hasPending)
+                emit(std::move(pending));
+            pending = Entry(std::move(key), count);
+            hasPending = true;
+        }
+        if (hasPending)
+            emit(std::move(pending));
+        if (merger.hasError() || failed)
+            return false;
+    }
+    for (const auto &path : runs)
+        std::remove(path.c_str());
+
+    if (topKmers) {
+        chunk.resize(top.size());
+        for (size_t i = chunk.size(); i > 0; --i) {
+            chunk[i - 1] = top.top();
+            top.pop();
+        }
+    } else {
+        std::sort(chunk.begin(), chunk.end(), byFrequency);
+    }
+
+    if (frequencyRuns.empty()) {
+        for (const auto &[kmer, freq] : chunk)
+            out << keyToString(kmer, size) << " " << freq << '\n';
+        out.flush();
+        return true;
+    }
+
+    // the last chunk is merged with the spilled ones, without writing it
+    if (!reduceRuns<Key>(frequencyRuns, directory, false, ByFrequency(), false, bufferSize))
+        return false;
+    RunMerger<Key, ByFrequency> frequencyMerger(frequencyRuns, false, ByFrequency(), bufferSize, &chunk);
+    while (frequencyMerger.next(key, count))
+        out << keyToString(key, size) << " " << count << '\n';
+    out.flush();
+    if (frequencyMerger.hasError())
+        return false;
+    for (const auto &path : frequencyRuns)
+        std::remove(path.c_str());
+    return true;
+}
+
+#endif // SPILLRUNS_H
@@ -0,0 +1,141 @@
+#ifndef UNIPROTINDEX_H
+#define UNIPROTINDEX_H
+
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Parallel.h"
+
+// The PDBs matched to each UniProt entry (written by kmers/uniprot_index.py,
+// or kmer_pipeline --uniprot-index), replacing one
+// pdb_output/uniprot/<id>.info file per UniProt entry.
+//
+// Text; a "UNIPROTIDX <version>" line, then one line
+// "<uniprot id> <pdb id> <resolution> <sequence length>" per PDB, in the
+// order they were matched.
+const char UNIPROT_INDEX_MAGIC[] = "UNIPROTIDX";
+const uint32_t UNIPROT_INDEX_VERSION = 1;
+
+struct PdbInfo {
+    std::string pdb_id;
+    double resolution;
+    int sequence_length;
+};
+
+struct UniprotGroup {
+    std::string uniprot_id;
+    std::vector<PdbInfo> pdbs;
+};
+
+// Reads the index at path, grouped by UniProt id (in order of first
+// appearance). Returns false, with the reason in error, if it is missing or
+// malformed.
+inline bool loadUniprotIndex(const std::string& path, std::vector<UniprotGroup>& groups, std::string& error) {
+    std::ifstream in(path);
+    std::string magic;
+    uint32_t version = 0;
+    if(!(in >> magic >> version) || magic != UNIPROT_INDEX_MAGIC || version != UNIPROT_INDEX_VERSION) {
+        error = path + " is not a UniProt index of version " + std::to_string(UNIPROT_INDEX_VERSION);
+        return false;
+    }
+
+    std::unordered_map<std::string, size_t> group_of; // uniprot id -> position in groups
+    std::string uniprot_id;
+    PdbInfo info;
+    while(in >> uniprot_id >> info.pdb_id >> info.resolution >> info.sequence_length) {
+        auto [it, added] = group_of.emplace(uniprot_id, groups.size());
+        if(added) {
+            groups.push_back({uniprot_id, {}});
+        }
+        groups[it->second].pdbs.push_back(info);
+    }
+    if(!in.eof()) {
+        error = path + " has a malformed line after " + std::to_string(group_of.size()) + " UniProt entries";
+        return false;
+    }
+    return true;
+}
+
+// Writes groups as a new index at path; false if it cannot be written.
+inline bool writeUniprotIndex(const std::string& path, const std::vector<UniprotGroup>& groups) {
+    std::ofstream out(path);
+    out << std::setprecision(std::numeric_limits<double>::max_digits10);
+    out << UNIPROT_INDEX_MAGIC << ' ' << UNIPROT_INDEX_VERSION << '\n';
+    for(const auto& group : groups) {
+        for(const auto& info : group.pdbs) {
+            out << group.uniprot_id << ' ' << info.pdb_id << ' ' << info.resolution << ' '
+                << info.sequence_length << '\n';
+        }
+    }
+    out.close();
+    return static_cast<bool>(out);
+}
+
+// Reads the .info files of earlier runs (a ">uniprot id" line, then
+// "<pdb id> <resolution> <sequence length> <sequence>" per PDB), one group
+// per file.
+inline std::vector<UniprotGroup> loadUniprotInfoFiles(const std::filesystem::path& uniprot_path) {
+    std::vector<UniprotGroup> groups;
+    for(const auto& entry : std::filesystem::directory_iterator(uniprot_path)) {
+        if(entry.path().extension() != ".info") {
+            continue;
+        }
+
+        UniprotGroup group{entry.path().stem().string(), {}};
+        std::ifstream file(entry.path());
+        std::string line;
+        while(std::getline(file, line)) {
+            if(line.empty() || line[0] == '>') {
+                continue;
+            }
+            std::istringstream iss(line);
+            PdbInfo info;
+            if(iss >> info.pdb_id >> info.resolution >> info.sequence_length) {
+                group.pdbs.push_back(info);
+            }
+        }
+        if(!group.pdbs.empty()) {
+            groups.push_back(std::move(group));
+        }
+    }
+    return groups;
+}
+
+// Picks the representative PDB of a UniProt entry: the best resolved one,
+// unless the next one is more than 25% longer. Sorts pdb_infos in place.
+inline PdbInfo selectPdb(std::vector<PdbInfo>& pdb_infos) {
+    // ties are broken by PDB id, so the choice does not depend on the order
+    // the PDBs were matched in
+    std::sort(pdb_infos.begin(), pdb_infos.end(), [](const PdbInfo& a, const PdbInfo& b) {
+        if(a.resolution != b.resolution) return a.resolution < b.resolution;
+        if(a.sequence_length != b.sequence_length) return a.sequence_length > b.sequence_length;
+        return a.pdb_id < b.pdb_id;
+    });
+
+    for (size_t i = 0; i + 1 < pdb_infos.size(); ++i) {
+        if (static_cast<double>(pdb_infos[i].sequence_length) >= 0.8 * pdb_infos[i + 1].sequence_length) {
+            return pdb_infos[i];
+        }
+    }
+    return pdb_infos.back();
+}
+
+// Selects the representative PDB of every UniProt entry, in parallel over
+// the entries.
+inline std::vector<std::string> selectRepresentatives(std::vector<UniprotGroup>& groups, unsigned int thread_count) {
+    std::vector<std::string> pdb_ids(groups.size());
+    parallelFor(groups.size(), thread_count, [&](size_t i, unsigned int) {
+        pdb_ids[i] = selectPdb(groups[i].pdbs).pdb_id;
+    });
+    return pdb_ids;
+}
+
+#endif // UNIPROTINDEX_H
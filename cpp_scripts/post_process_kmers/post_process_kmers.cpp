@@ -8,67 +8,270 @@
 #include <algorithm>
 #include <map>
 #include <iomanip>
+#include <string_view>
+#include <atomic>
+#include <mutex>
+#include <iterator>
+#include <memory>
+#include <chrono>
 
-struct PdbInfo {
-    std::string pdb_id;
-    double resolution;
-    int sequence_length;
-};
+#include "KmerCodec.h"
+#include "KmerCounts.h"
+#include "Parallel.h"
+#include "KmerCorpus.h"
+#include "UniprotIndex.h"
+#include "CountState.h"
+#include "../extract_pdb_coordinates/RunStats.h"
 
 namespace fs = std::filesystem;
 
-std::unordered_map<std::string, int> global_kmers;
 bool process_all_pdbs = false;
-int kmer_size = 12;
+CountOptions count_options;
+unsigned int thread_count = 1;
+size_t memory_limit_mb = 0; // 0: no limit
+size_t memory_budget_mb = 0; // --memory-budget; 0: count in memory only
+std::string spill_directory = fs::temp_directory_path().string();
+std::string state_path; // --state; empty: count everything
+std::string stats_path; // --stats; empty: no statistics
+double stats_interval = 60;
+RunStats* run_stats = nullptr;
+
+// stages timed for --stats
+enum CountStage { STAGE_SELECT, STAGE_LOAD_STATE, STAGE_READ, STAGE_COUNT, STAGE_WRITE, COUNT_STAGES };
+const char* const count_stage_name[] = {"select PDBs", "load state", "read", "count", "write"};
+
+// outcome of a PDB in --stats
+enum CountOutcome { PDB_ADDED, PDB_SUBTRACTED, PDB_EMPTY, COUNT_OUTCOMES };
+const char* const count_outcome_name[] = {"added", "subtracted", "empty"};
 
-std::vector<std::string> readUniprotFiles(const fs::path& uniprot_path) {
-    std::vector<std::string> file_list;
-    for(const auto& entry : fs::directory_iterator(uniprot_path)) {
-        file_list.push_back(entry.path().string());
+// count that, added to a KmerTable, subtracts one (counts wrap around)
+const uint32_t SUBTRACT_ONE = ~0u;
+
+// The k-mers of every PDB: in the memory-mapped corpus pdb_output/kmers.corpus,
+// or, for output of older runs, in one .kmers file per PDB.
+struct KmerSource {
+    fs::path pdbs_path;
+    KmerCorpus corpus;
+    bool use_corpus = false;
+
+    // PDB ids of all PDBs
+    std::vector<std::string> pdbIds() const {
+        std::vector<std::string> ids;
+        if(use_corpus) {
+            for(const auto& entry : corpus.entries()) {
+                ids.push_back(entry.pdbId);
+            }
+        } else {
+            for(const auto& entry : fs::directory_iterator(pdbs_path)) {
+                if(entry.path().extension() == ".kmers") {
+                    ids.push_back(entry.path().stem().string());
+                }
+            }
+        }
+        return ids;
     }
-    return file_list;
-}
 
-PdbInfo parseLine(const std::string& line) {
-    std::istringstream iss(line);
-    PdbInfo info;
-    iss >> info.pdb_id >> info.resolution >> info.sequence_length;
-    return info;
-}
+    // k-mers of pdb_id, one per line (empty if there are none), viewing
+    // either the corpus or buffer
+    std::string_view kmers(const std::string& pdb_id, std::string& buffer) const {
+        if(use_corpus) {
+            const KmerCorpus::Entry* entry = corpus.find(pdb_id);
+            return entry ? corpus.kmers(*entry) : std::string_view();
+        }
+
+        std::ifstream file(pdbs_path / (pdb_id + ".kmers"), std::ios::binary);
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return buffer;
+    }
+};
+
+// Counts the k-mers of all sizes in one pass over all files, and writes one
+// table per size, most frequent first. Every thread counts its files into
+// its own KmerCounts. With --memory-budget, a thread that outgrows its share
+// of the budget spills its tables to sorted runs in spill_directory, and the
+// counts are then merged from the runs (see SpillRuns.h).
+//
+// pdb_ids are all PDBs with -a, and the representatives of the UniProt
+// entries otherwise. With --state, they are only the PDBs not counted in
+// base, the counts of the previous run, and the k-mers of the removed entries
+// are subtracted from it; the new counts are then written to state.
+int countKmers(const std::vector<std::string>& pdb_ids, const std::vector<KmerCorpus::Entry>& removed,
+               std::unique_ptr<KmerCounts> base, const KmerSource& source, unsigned int thread_count,
+               CountStateWriter* state) {
+    int total_files = pdb_ids.size() + removed.size();
+    std::vector<KmerCounts> thread_counts;
+    for(unsigned int t = 0; t < thread_count; ++t) {
+        thread_counts.emplace_back(count_options);
+    }
+    std::vector<std::string> thread_buffers(thread_count);
+    std::vector<StageClock> thread_clocks(thread_count, StageClock(COUNT_STAGES));
+    std::atomic<int> processed{0};
+    std::mutex progress_mutex;
+
+    std::unique_ptr<KmerSpill> spill;
+    std::atomic<bool> spill_failed{false};
+    if(memory_budget_mb) {
+        spill = std::make_unique<KmerSpill>();
+        std::string error;
+        if(!spill->directory.create(spill_directory, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+
+    parallelFor(total_files, thread_count, [&](size_t i, unsigned int thread) {
+        KmerCounts& counts = thread_counts[thread];
+        StageClock& clock = thread_clocks[thread];
+        auto start = std::chrono::steady_clock::now();
+        if(run_stats) {
+            clock.reset();
+            clock.switchTo(STAGE_READ);
+        }
+
+        std::string_view kmers;
+        if(i < pdb_ids.size()) {
+            kmers = source.kmers(pdb_ids[i], thread_buffers[thread]);
+        } else {
+            kmers = source.corpus.kmers(removed[i - pdb_ids.size()]);
+        }
+        if(run_stats) {
+            clock.count(STAGE_READ, 1, kmers.size());
+            clock.switchTo(STAGE_COUNT);
+        }
+        countKmerLines(kmers, counts, i < pdb_ids.size() ? 1 : SUBTRACT_ONE);
+
+        if(run_stats) {
+            clock.count(STAGE_COUNT, std::count(kmers.begin(), kmers.end(), '\n'), kmers.size());
+            clock.stop();
+            CountOutcome outcome = kmers.empty() ? PDB_EMPTY : i < pdb_ids.size() ? PDB_ADDED : PDB_SUBTRACTED;
+            const std::string& name = i < pdb_ids.size() ? pdb_ids[i] : removed[i - pdb_ids.size()].pdbId;
+            run_stats->addItem(clock, outcome,
+                               std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), name);
+        }
+
+        // a thread that outgrows its share of --memory-limit continues with
+        // bounded-memory sketches
+        if(memory_limit_mb && !counts.sketching && counts.memoryBytes() > memory_limit_mb * 1000000 / thread_count) {
+            counts.startSketching();
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            std::cerr << std::endl << "Memory limit reached, counting approximately from here on" << std::endl;
+        }
+        if(spill && counts.memoryBytes() > memory_budget_mb * 1000000 / thread_count && !spill_failed) {
+            if(!spillCounts(counts, *spill)) {
+                spill_failed = true;
+            }
+        }
 
-PdbInfo selectPdb(const std::vector<PdbInfo>& pdb_infos) {
-    std::vector<PdbInfo> sorted_infos = pdb_infos;
-    std::sort(sorted_infos.begin(), sorted_infos.end(), [](const PdbInfo& a, const PdbInfo& b) {
-        return a.resolution < b.resolution || (a.resolution == b.resolution && a.sequence_length > b.sequence_length);
+        int done = ++processed;
+        if(done % 100 == 0 || done == total_files) {
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            std::cerr << "\rProcessed " << done << " / " << total_files << "; "
+                      << std::fixed << std::setprecision(2) << static_cast<double>(done) / total_files * 100 << "%";
+            std::cerr.flush();
+        }
     });
-    
-    for (size_t i = 0; i < sorted_infos.size() - 1; ++i) {
-        if (static_cast<double>(sorted_infos[i].sequence_length) >= 0.8 * sorted_infos[i + 1].sequence_length) {
-            return sorted_infos[i];
+
+    // the counts of the previous run are merged like those of one more thread
+    if(base) {
+        thread_counts.push_back(std::move(*base));
+    }
+
+    std::cerr << std::endl << "Prepairing results..." << std::endl;
+
+    StageClock clock(COUNT_STAGES);
+    clock.switchTo(STAGE_WRITE);
+    if(spill_failed) {
+        return 1;
+    }
+    if(spill && !spill->empty()) {
+        // what is left in memory is spilled too, and everything merged from the runs
+        parallelFor(thread_counts.size(), thread_count, [&](size_t t, unsigned int) {
+            if(!spillCounts(thread_counts[t], *spill)) {
+                spill_failed = true;
+            }
+        });
+        size_t memory_bytes = memory_budget_mb * 1000000;
+        int result = spill_failed
+            || writeSpilledSizes(*spill, thread_counts[0].packed, &KmerSpill::packed, count_options, memory_bytes)
+            || writeSpilledSizes(*spill, thread_counts[0].widePacked, &KmerSpill::widePacked, count_options,
+                                 memory_bytes)
+            || writeSpilledSizes(*spill, thread_counts[0].strings, &KmerSpill::strings, count_options, memory_bytes);
+        clock.stop();
+        if(run_stats) {
+            run_stats->addStages(clock);
         }
+        return result;
     }
-    return sorted_infos.back();
+
+    int result = writeSizes(thread_counts, &KmerCounts::packed, count_options, thread_count, state)
+        || writeSizes(thread_counts, &KmerCounts::widePacked, count_options, thread_count, state)
+        || writeSizes(thread_counts, &KmerCounts::strings, count_options, thread_count, nullptr);
+    if(!result && state && !state->commit()) {
+        std::cerr << "Could not write " << state_path << std::endl;
+        result = 1;
+    }
+    clock.stop();
+    if(run_stats) {
+        run_stats->addStages(clock);
+    }
+    return result;
 }
 
-PdbInfo parseInfoFile(const std::string& file_path) {
-    std::ifstream file(file_path);
-    std::string line;
-    std::vector<PdbInfo> pdb_infos;
-    while(std::getline(file, line)) {
-        pdb_infos.push_back(parseLine(line));
+// Loads the state of the previous run (--state) into base, if it has counts
+// of the same sizes and PDB selection. pdb_ids is then cut down to the PDBs
+// whose corpus entries it did not count, and removed set to the entries it
+// counted that are no longer in pdb_ids (or were replaced).
+bool loadCountState(const KmerCorpus& corpus, const CountStateHeader& header, std::vector<std::string>& pdb_ids,
+                    std::vector<KmerCorpus::Entry>& removed, KmerCounts& base) {
+    CountStateReader reader;
+    std::string error;
+    if(!reader.open(state_path, header, error)) {
+        std::cerr << error << "; counting all PDBs" << std::endl;
+        return false;
     }
 
-    return selectPdb(pdb_infos);
-}
+    std::unordered_map<std::string, const KmerCorpus::Entry*> counted;
+    for(const auto& entry : reader.pdbs()) {
+        if(entry.offset + entry.length > corpus.dataSize()) {
+            std::cerr << state_path << " does not belong to this corpus; counting all PDBs" << std::endl;
+            return false;
+        }
+        counted[entry.pdbId] = &entry;
+    }
 
-void parseKmersFile(const std::string& file_path) {
-    std::ifstream file(file_path);
-    std::string line;
-    while(std::getline(file, line)) {
-        if(line.length() >= kmer_size) {
-            global_kmers[line.substr(0, kmer_size)]++;
+    std::vector<std::string> added;
+    for(const auto& pdb_id : pdb_ids) {
+        const KmerCorpus::Entry* entry = corpus.find(pdb_id);
+        auto it = counted.find(pdb_id);
+        if(it != counted.end() && entry && it->second->offset == entry->offset && it->second->length == entry->length) {
+            counted.erase(it);
+        } else {
+            added.push_back(pdb_id);
         }
     }
+    std::vector<KmerCorpus::Entry> subtracted;
+    for(const auto& [_pdb_id, entry] : counted) {
+        subtracted.push_back(*entry);
+    }
+
+    for(size_t i = 0; i < base.packed.tables.size(); ++i) {
+        if(!reader.readTable(base.packed.tables[i])) {
+            std::cerr << state_path << " is truncated; counting all PDBs" << std::endl;
+            return false;
+        }
+    }
+    for(size_t i = 0; i < base.widePacked.tables.size(); ++i) {
+        if(!reader.readTable(base.widePacked.tables[i])) {
+            std::cerr << state_path << " is truncated; counting all PDBs" << std::endl;
+            return false;
+        }
+    }
+
+    std::cerr << "Updating the counts of " << reader.pdbs().size() << " PDBs: " << added.size()
+              << " to add, " << subtracted.size() << " to subtract" << std::endl;
+    pdb_ids.swap(added);
+    removed.swap(subtracted);
+    return true;
 }
 
 int main(int argc, char** argv) {
@@ -77,61 +280,181 @@ int main(int argc, char** argv) {
         if(arg == "-a") {
             process_all_pdbs = true;
         } else if(arg == "-k" && i + 1 < argc) {
-            kmer_size = std::stoi(argv[++i]);
+            if(!parseKmerSizes(argv[++i], count_options)) {
+                std::cerr << "Invalid k-mer size: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if(arg == "--top" && i + 1 < argc) {
+            count_options.top_kmers = std::stoul(argv[++i]);
+        } else if(arg == "--approximate") {
+            count_options.approximate = true;
+        } else if(arg == "--memory-limit" && i + 1 < argc) {
+            memory_limit_mb = std::stoul(argv[++i]);
+        } else if(arg == "--memory-budget" && i + 1 < argc) {
+            memory_budget_mb = std::stoul(argv[++i]);
+        } else if(arg == "--spill-dir" && i + 1 < argc) {
+            spill_directory = argv[++i];
+        } else if(arg == "--epsilon" && i + 1 < argc) {
+            count_options.sketch_parameters.epsilon = std::stod(argv[++i]);
+        } else if(arg == "--delta" && i + 1 < argc) {
+            count_options.sketch_parameters.delta = std::stod(argv[++i]);
+        } else if(arg == "-o" && i + 1 < argc) {
+            count_options.output_prefix = argv[++i];
+        } else if(arg == "-j" && i + 1 < argc) {
+            thread_count = std::stoi(argv[++i]);
+        } else if(arg == "--state" && i + 1 < argc) {
+            state_path = argv[++i];
+        } else if(arg == "--stats" && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if(arg == "--stats-interval" && i + 1 < argc) {
+            stats_interval = std::stod(argv[++i]);
         } else if(arg == "-h" || arg == "--help") {
             std::cout << "Usage: " << argv[0] << " [OPTIONS]\n"
                       << "Options:\n"
                       << "  -a            Process all PDBs\n"
-                      << "  -k <value>    Specify the size of the k-mers\n"
+                      << "  -k <value>    Specify the size of the k-mers, or a range of sizes\n"
+                      << "                (e.g. 6-20) to count in one pass\n"
+                      << "  -o <prefix>   Output prefix for a range of sizes; the k-mers of\n"
+                      << "                size K go to <prefix>K.txt (default kmers_k)\n"
+                      << "  -j <threads>  Count with this many threads (0 = all cores, default 1)\n"
+                      << "  --top <n>     Print only the n most frequent k-mers\n"
+                      << "  --approximate With --top, count with bounded memory (Count-Min +\n"
+                      << "                Space-Saving); prints \"kmer count lower upper\"\n"
+                      << "  --memory-limit <MB>\n"
+                      << "                With --top, switch to approximate counting when the\n"
+                      << "                exact tables outgrow this limit\n"
+                      << "  --memory-budget <MB>\n"
+                      << "                Count exactly within about this much memory: tables\n"
+                      << "                that outgrow it are spilled to sorted runs on disk,\n"
+                      << "                and merged into the output\n"
+                      << "  --spill-dir <dir>\n"
+                      << "                Directory for the runs (default: the temp directory)\n"
+                      << "  --epsilon <e> Approximate counts are at most e * (total k-mers)\n"
+                      << "                too high (default 1e-5)...\n"
+                      << "  --delta <d>   ...with probability 1 - d (default 0.01)\n"
+                      << "  --state <file>\n"
+                      << "                Keep the counts in <file>, and on the next run only count\n"
+                      << "                the PDBs added to (or removed from) the corpus since\n"
+                      << "  --stats <file>\n"
+                      << "                Write statistics of the run to <file> as JSON: time and\n"
+                      << "                bytes per stage, per-PDB latency histogram, slowest PDBs\n"
+                      << "                and peak RSS\n"
+                      << "  --stats-interval <s>\n"
+                      << "                Also write them every <s> seconds (default 60, 0 = only\n"
+                      << "                at the end)\n"
                       << "  -h, --help    Display this help message and exit\n";
             return 0;
         }
     }
 
-    fs::path uniprot_path = "./pdb_output/uniprot";
-    fs::path pdbs_path = "./pdb_output/pdbs";
-    std::vector<std::string> file_list;
+    SketchParameters& sketch_parameters = count_options.sketch_parameters;
+    if((count_options.approximate || memory_limit_mb) && !count_options.top_kmers) {
+        std::cerr << "--approximate and --memory-limit require --top" << std::endl;
+        return 1;
+    }
+    if(!state_path.empty() && (count_options.approximate || memory_limit_mb)) {
+        std::cerr << "--state can not be combined with --approximate or --memory-limit" << std::endl;
+        return 1;
+    }
+    if(memory_budget_mb && (count_options.approximate || memory_limit_mb || !state_path.empty())) {
+        std::cerr << "--memory-budget can not be combined with --approximate, --memory-limit or --state" << std::endl;
+        return 1;
+    }
+    if(sketch_parameters.epsilon <= 0 || sketch_parameters.delta <= 0 || sketch_parameters.delta >= 1) {
+        std::cerr << "--epsilon must be positive and --delta in (0, 1)" << std::endl;
+        return 1;
+    }
+    sketch_parameters.top = count_options.top_kmers;
 
-    if(process_all_pdbs) {
-        for(const auto& entry : fs::directory_iterator(pdbs_path)) {
-            file_list.push_back(entry.path().c_str());
-        }
-    } else {
-        file_list = readUniprotFiles(uniprot_path);
+    // the final statistics are also written if main returns early
+    std::unique_ptr<RunStats> stats;
+    std::unique_ptr<PeriodicStatsWriter> stats_writer;
+    StageClock main_clock(COUNT_STAGES);
+    if(!stats_path.empty()) {
+        stats = std::make_unique<RunStats>("post_process_kmers",
+            std::vector<std::string>(count_stage_name, count_stage_name + COUNT_STAGES),
+            std::vector<std::string>(count_outcome_name, count_outcome_name + COUNT_OUTCOMES));
+        stats_writer = std::make_unique<PeriodicStatsWriter>(*stats, stats_path, stats_interval);
+        run_stats = stats.get();
     }
+    main_clock.switchTo(STAGE_SELECT);
 
-    int total_files = file_list.size();
+    fs::path uniprot_index_path = "./pdb_output/uniprot.index";
+    fs::path uniprot_path = "./pdb_output/uniprot"; // .info files of earlier runs
+    fs::path corpus_path = "./pdb_output/kmers.corpus";
+    KmerSource source;
+    source.pdbs_path = "./pdb_output/pdbs";
+    std::vector<std::string> pdb_ids;
+    thread_count = resolveThreadCount(thread_count);
 
-    for(int i = 0; i < total_files; ++i) {
+    if(fs::exists(corpus_path)) {
+        std::string error;
+        if(!source.corpus.open(corpus_path, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        source.use_corpus = true;
         if(process_all_pdbs) {
-            parseKmersFile(file_list[i]);
-        } else {
-            PdbInfo selected_pdb = parseInfoFile(file_list[i]);
-
-            std::string kmers_file_path = (pdbs_path / (selected_pdb.pdb_id + ".kmers")).c_str();
-            if(fs::exists(kmers_file_path)) {
-                parseKmersFile(kmers_file_path);
-            }
+            source.corpus.adviseSequential();
         }
+    }
 
-        if((i + 1) % 100 == 0 || i + 1 == total_files) {
-            std::cerr << "\rProcessed " << (i + 1) << " / " << total_files << "; " 
-                      << std::fixed << std::setprecision(2) << static_cast<double>(i + 1) / total_files * 100 << "%";
-            std::cerr.flush();
+    if(process_all_pdbs) {
+        pdb_ids = source.pdbIds();
+    } else {
+        std::vector<UniprotGroup> groups;
+        if(fs::exists(uniprot_index_path)) {
+            std::string error;
+            if(!loadUniprotIndex(uniprot_index_path, groups, error)) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+        } else if(fs::exists(uniprot_path)) {
+            groups = loadUniprotInfoFiles(uniprot_path);
         }
+        pdb_ids = selectRepresentatives(groups, thread_count);
     }
 
-    std::cerr << std::endl << "Prepairing results..." << std::endl;
-
-    std::vector<std::pair<std::string, int>> sorted_kmers(global_kmers.begin(), global_kmers.end());
-
-    std::sort(sorted_kmers.begin(), sorted_kmers.end(), [](const auto& a, const auto& b) {
-        return a.second > b.second;
-    });
+    std::vector<KmerCorpus::Entry> removed;
+    std::unique_ptr<KmerCounts> base;
+    CountStateWriter state_writer;
+    CountStateWriter* state = nullptr;
+    if(!state_path.empty() && !source.use_corpus) {
+        std::cerr << "--state requires the k-mer corpus; counting all PDBs without it" << std::endl;
+    } else if(!state_path.empty() && count_options.max_kmer_size > MAX_WIDE_PACKED_KMER_SIZE) {
+        std::cerr << "--state only keeps k-mers of up to " << MAX_WIDE_PACKED_KMER_SIZE
+                  << " residues; counting all PDBs without it" << std::endl;
+    } else if(!state_path.empty()) {
+        CountStateHeader header{process_all_pdbs ? COUNT_STATE_ALL_PDBS : 0, count_options.min_kmer_size,
+                                count_options.max_kmer_size};
+        std::vector<const KmerCorpus::Entry*> counted;
+        for(const auto& pdb_id : pdb_ids) {
+            if(const KmerCorpus::Entry* entry = source.corpus.find(pdb_id)) {
+                counted.push_back(entry);
+            }
+        }
+        if(!state_writer.open(state_path, header, counted)) {
+            std::cerr << "Could not write " << state_path << std::endl;
+            return 1;
+        }
+        state = &state_writer;
 
-    for(const auto& [kmer, freq] : sorted_kmers) {
-        std::cout << kmer << " " << freq << std::endl;
+        if(fs::exists(state_path)) {
+            main_clock.switchTo(STAGE_LOAD_STATE);
+            base = std::make_unique<KmerCounts>(count_options);
+            if(!loadCountState(source.corpus, header, pdb_ids, removed, *base)) {
+                base.reset();
+            }
+        }
     }
 
-    return 0;
+    main_clock.stop();
+    if(run_stats) {
+        run_stats->addStages(main_clock);
+    }
+    int result = countKmers(pdb_ids, removed, std::move(base), source, thread_count, state);
+    if(stats_writer && !stats_writer->finish()) {
+        std::cerr << "Could not write " << stats_path << std::endl;
+    }
+    return result;
 }
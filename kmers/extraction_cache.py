@@ -0,0 +1,53 @@
+"""
+Extraction result of every PDB file of a run, so that a later run with --incremental only extracts the files that
+were added or changed since. A file is unchanged if its path, modification time and size are; the results are only
+reused by a run with the same key (record format, extractor binary, UniProt source and processing mode).
+
+    'EXTRACTCACHE <version>', 'key <key>', then one tab-separated line per file:
+    '<path> <mtime in ns> <size> <code> <pdb id> <uniprot id> <resolution> <sequence length>'
+
+pdb id, uniprot id, resolution and sequence length are '-' where the file was not added to the k-mer corpus
+(code other than SUCCESS), or has no UniProt match (handling all PDBs).
+"""
+import os
+from collections import namedtuple
+
+MAGIC = 'EXTRACTCACHE'
+VERSION = 1
+
+CachedResult = namedtuple('CachedResult', 'mtime_ns size code pdb_id uniprot_id resolution sequence_length')
+
+
+def file_signature(path):
+    """(mtime in ns, size) of path"""
+    stat = os.stat(path)
+    return stat.st_mtime_ns, stat.st_size
+
+
+def load_cache(path, key):
+    """Results by file path, or {} if there is no cache at path, or it was written with another key"""
+    if not os.path.exists(path):
+        return {}
+
+    results = {}
+    with open(path) as cache:
+        magic, version = cache.readline().split()
+        if magic != MAGIC or int(version) != VERSION:
+            raise ValueError(f'{path} is not an extraction cache of version {VERSION}')
+        if cache.readline().rstrip('\n') != f'key {key}':
+            return {}
+        for line in cache:
+            file_path, mtime_ns, size, code, pdb_id, uniprot_id, resolution, sequence_length = \
+                line.rstrip('\n').split('\t')
+            results[file_path] = CachedResult(int(mtime_ns), int(size), code, pdb_id, uniprot_id, resolution,
+                                              sequence_length)
+    return results
+
+
+def save_cache(path, key, results):
+    """Replaces the cache at path with results (by file path); an interrupted save leaves the old cache"""
+    with open(f'{path}.tmp', 'w') as cache:
+        cache.write(f'{MAGIC} {VERSION}\nkey {key}\n')
+        for file_path in sorted(results):
+            cache.write('\t'.join([file_path, *map(str, results[file_path])]) + '\n')
+    os.replace(f'{path}.tmp', path)
@@ -0,0 +1,119 @@
+"""
+Append-only store of the proximity k-mers of all PDBs, replacing one .kmers file per PDB.
+The layout is documented in cpp_scripts/post_process_kmers/KmerCorpus.h:
+
+    <path>      16-byte header (b'KMERCORP', uint32 version, uint32 reserved), then the k-mers of each PDB,
+                one per line, as in a .kmers file
+    <path>.idx  'KMERCORP <version>', then one line '<pdb id> <offset> <length in bytes> <k-mer count>' per PDB
+
+Entries are appended to both files, so a corpus can grow over several runs. The index line of an entry is written
+after its data, so an interrupted run leaves a readable corpus. A PDB added more than once is represented by its
+last entry. retain_entries drops the entries of other PDBs from the index; their data stays in place, so k-mer counts
+of an earlier run (post_process_kmers --state) can still be taken back.
+"""
+import mmap
+import os
+import struct
+
+MAGIC = b'KMERCORP'
+VERSION = 1
+
+_HEADER = struct.Struct('<8sII')
+
+
+class KmerCorpusWriter:
+    def __init__(self, path):
+        self.path = path
+        self._data = open(path, 'ab')
+        if self._data.tell() == 0:
+            self._data.write(_HEADER.pack(MAGIC, VERSION, 0))
+
+        index_path = f'{path}.idx'
+        new_index = not os.path.exists(index_path) or os.path.getsize(index_path) == 0
+        self._index = open(index_path, 'a')
+        if new_index:
+            self._index.write(f'{MAGIC.decode()} {VERSION}\n')
+        self._pending = []  # index lines of entries whose data may not be flushed yet
+
+    def add(self, pdb_id, kmers):
+        data = ''.join(f'{kmer}\n' for kmer in kmers).encode('ascii')
+        offset = self._data.tell()
+        self._data.write(data)
+        self._pending.append(f'{pdb_id} {offset} {len(data)} {len(kmers)}\n')
+        if len(self._pending) >= 1000:
+            self.flush()
+
+    def flush(self):
+        """Flushes the data, then the index lines pointing to it."""
+        self._data.flush()
+        self._index.writelines(self._pending)
+        self._index.flush()
+        self._pending.clear()
+
+    def close(self):
+        self.flush()
+        self._data.close()
+        self._index.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+def retain_entries(path, pdb_ids):
+    """Rewrites the index of the corpus at path to hold only the (last) entries of pdb_ids."""
+    index_path = f'{path}.idx'
+    entries = {}
+    with open(index_path) as index:
+        header = index.readline()
+        for line in index:
+            entries[line.split(maxsplit=1)[0]] = line
+
+    with open(f'{index_path}.tmp', 'w') as index:
+        index.write(header)
+        index.writelines(line for pdb_id, line in entries.items() if pdb_id in pdb_ids)
+    os.replace(f'{index_path}.tmp', index_path)
+
+
+class KmerCorpus:
+    """Read-only, memory-mapped corpus, with random access by PDB id."""
+    def __init__(self, path):
+        self._entries = {}
+        with open(f'{path}.idx') as index:
+            magic, version = index.readline().split()
+            if magic != MAGIC.decode() or int(version) != VERSION:
+                raise ValueError(f'{path}.idx is not a k-mer corpus index of version {VERSION}')
+            for line in index:
+                pdb_id, offset, length, count = line.split()
+                self._entries[pdb_id] = (int(offset), int(length), int(count))
+
+        with open(path, 'rb') as f:
+            self._mapped = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, _ = _HEADER.unpack_from(self._mapped)
+        if magic != MAGIC or version != VERSION:
+            raise ValueError(f'{path} is not a k-mer corpus of version {VERSION}')
+
+    def __contains__(self, pdb_id):
+        return pdb_id in self._entries
+
+    def __len__(self):
+        return len(self._entries)
+
+    def pdb_ids(self):
+        """PDB ids, in file order"""
+        return sorted(self._entries, key=lambda pdb_id: self._entries[pdb_id][0])
+
+    def kmers(self, pdb_id):
+        offset, length, _ = self._entries[pdb_id]
+        return self._mapped[offset:offset + length].decode('ascii').splitlines()
+
+    def close(self):
+        self._mapped.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
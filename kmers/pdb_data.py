@@ -14,15 +14,25 @@ The format of the byte stream is as follows:
         'parsed:  {parsed_sequence}' (str)
     5. Lines 5 to n are other sequences that are found in the PDB file (SEQRES)
         'other:   {other_sequence}' (str)
-    6. Lines n+1 is a blank line
-    7. Lines n+2 to m are the coordinates of the PDB file (ATOM)
+    6. Line n+1 is the sequence number of the first residue:
+        'initres: {first_residue_number}' (int)
+    7. Line n+2 is a blank line
+    8. Lines n+3 to m are the coordinates of the PDB file (ATOM)
         '{residue_name [e.g. A/E/M]} {x} {y} {z}' (char, float, float, float)
+
+If extract_pdb_coordinates is run with --kmers, the coordinates are replaced by proximity k-mers:
+    7. Line n+2 is the number of k-mers:
+        'kmers:   {count}' (int)
+    8. Line n+3 is a blank line
+    9. Lines n+4 to m are the k-mers, one per residue (str)
+
+With --format binary, the same data is written as binary records instead; see kmers/pdb_records.py.
 """
 
 
 class PDBData:
-    """Takes in a byte stream"""
-    def __init__(self, pdb_byte_stream):
+    """Takes in a byte stream (or nothing, see from_record)"""
+    def __init__(self, pdb_byte_stream=None):
         self._success = None
         self._pdb_id = None
         self._resolution = None
@@ -30,12 +40,42 @@ class PDBData:
         self._first_residue_number = None
         self._residue_list = []
         self._coordinates = []
+        self._coordinate_arrays = None
+        self._kmers = None
 
         self._input_uniprot_ids = []
+        self._matched_uniprot_id = None
         self._input_matched_sequence = None
         self._input_other_sequences = []
 
-        self._parse(pdb_byte_stream)
+        if pdb_byte_stream is not None:
+            self._parse(pdb_byte_stream)
+
+    @classmethod
+    def from_record(cls, success, pdb_id, resolution, uniprot_ids, matched_uniprot_id, matched_sequence,
+                    parsed_sequence, other_sequences, first_residue_number, residues, coordinates, kmers):
+        """
+        Creates a PDBData from the fields of a binary record (see kmers/pdb_records.py).
+        coordinates are the x, y and z arrays; the (x, y, z) tuples are only built when accessed.
+        """
+        pdb_data = cls()
+        pdb_data._success = success
+        if not success:  # the text format carries no data for invalid files either
+            return pdb_data
+
+        pdb_data._pdb_id = pdb_id
+        # float32 in the record; rounded like the text output, so that both formats give the same value
+        pdb_data._resolution = float(f'{resolution:.6g}')
+        pdb_data._input_uniprot_ids = uniprot_ids
+        pdb_data._matched_uniprot_id = matched_uniprot_id
+        pdb_data._input_matched_sequence = matched_sequence
+        pdb_data._parsed_sequence = parsed_sequence
+        pdb_data._input_other_sequences = other_sequences
+        pdb_data._first_residue_number = first_residue_number
+        pdb_data._residue_list = list(residues)
+        pdb_data._coordinate_arrays = coordinates
+        pdb_data._kmers = kmers
+        return pdb_data
 
     def _parse(self, pdb_byte_stream):
         lines = pdb_byte_stream.decode('utf-8').split("\n")
@@ -71,6 +111,13 @@ class PDBData:
         # parse the first residue number (initres)
         self._first_residue_number = int(lines[idx].split(': ')[1])
 
+        # Parse the k-mers, if computed by extract_pdb_coordinates
+        if lines[idx + 1].startswith('kmers:   '):
+            kmer_count = int(lines[idx + 1].split(': ')[1])
+            idx += 3  # skip the initres, kmer count and blank line
+            self._kmers = lines[idx:idx + kmer_count]
+            return
+
         # Parse the coordinates
         idx += 2  # skip the initres and blank line
         while idx < len(lines) and lines[idx].strip():  # Ensure we are not at the end or at a blank line
@@ -118,10 +165,29 @@ class PDBData:
     def uniprot_ids(self):
         return self._input_uniprot_ids
 
+    @property
+    def matched_uniprot_id(self):
+        """
+        The UniProt id matched by extract_pdb_coordinates --uniprot-store (binary records only), or None.
+        :return:
+        """
+        return self._matched_uniprot_id
+
     @property
     def residue_list(self):
         return self._residue_list
 
     @property
     def coordinates(self):
+        if self._coordinate_arrays is not None:
+            self._coordinates = list(zip(*self._coordinate_arrays))
+            self._coordinate_arrays = None
         return self._coordinates
+
+    @property
+    def kmers(self):
+        """
+        Proximity k-mers computed by extract_pdb_coordinates (--kmers), or None if coordinates were extracted.
+        :return:
+        """
+        return self._kmers
@@ -1,97 +1,160 @@
-import gzip
+import os
 import sqlite3
 import subprocess
 import time
 from pathlib import Path
 
 from kmers.calculate_kmer import calculate_kmers
+from kmers.extraction_cache import CachedResult, file_signature, load_cache, save_cache
+from kmers.kmer_corpus import KmerCorpusWriter, retain_entries
 from kmers.pdb_data import PDBData
+from kmers.pdb_records import FORMAT_VERSION, read_records
+from kmers.uniprot_index import UniprotIndexWriter
+
+EXTRACTOR = 'bin/extract_pdb_coordinates'
+
+# outcomes that may not recur, and are not cached
+RETRIED_CODES = {'FILE_NOT_READABLE', 'UNEXPECTED_ERROR'}
 
 
 class GZProcessor:
-    def __init__(self, db_path, process_dir, out_uniprot_dir, out_pdbs_dir, handle_all_pdbs):
+    def __init__(self, db_path, process_dir, out_uniprot_index_path, out_corpus_path, out_cache_path,
+                 handle_all_pdbs):
         self.db_path = db_path
         self.process_dir = process_dir
-        self.out_uniprot_dir = out_uniprot_dir
-        self.out_pdbs_dir = out_pdbs_dir
+        self.out_uniprot_index_path = out_uniprot_index_path
+        self.out_corpus_path = out_corpus_path
+        self.out_cache_path = out_cache_path
+        self.corpus = None
+        self.results = {}  # CachedResult by file path
+        self.signatures = {}  # (mtime, size) by file path, taken before extraction
         self.handle_all_pdbs = handle_all_pdbs
 
-        if not self.handle_all_pdbs:
+        # a sequence store is matched against by extract_pdb_coordinates, a database here
+        self.conn = None
+        self.uses_store = not self.handle_all_pdbs and str(self.db_path).endswith('.store')
+        if not self.handle_all_pdbs and not self.uses_store:
             self.conn = sqlite3.connect(f'file:{self.db_path}?mode=ro', uri=True)
 
         self.codes = {'SUCCESS': 0}
         self.max_pdb_count = 1  # to avoid division by zero
         self.cur_pdb_count = 0
 
-    def process_gz_file(self, gz_file):
+    def process_parsed_pdb(self, gz_file, code, pdb_data):
+        signature = self.signatures[gz_file]
 
-        # 1. extract coordinates
-        try:
-            parsed_pdb = self.extract_coordinates(gz_file)
-            self.codes['SUCCESS'] += 1
-        except Exception as e:
-            self.codes[str(e)] = self.codes.get(str(e), 0) + 1
+        # 1. record extraction outcome, reject if unsuccessful
+        if code != 'SUCCESS':
+            if code in RETRIED_CODES:
+                self.codes[code] = self.codes.get(code, 0) + 1
+            else:
+                self.results[gz_file] = CachedResult(*signature, code, '-', '-', '-', '-')
             return
 
-        # 2. parse data
-        pdb_data = PDBData(parsed_pdb)
+        # 2. (data was parsed from the binary record by read_records)
 
-        # 3. find matching uniprot entry, reject if not found
-        if not self.handle_all_pdbs:
+        # 3. find matching uniprot entry, reject if not found (with a store, entries without a match already
+        # have the code NO_UNIPROT_ID)
+        uniprot_id = '-'
+        if self.uses_store:
+            uniprot_id = pdb_data.matched_uniprot_id
+        elif not self.handle_all_pdbs:
             uniprot_id = self.get_matching_uniprot_entry(pdb_data)
             if uniprot_id is None:
-                self.codes['SUCCESS'] -= 1
-                self.codes['NO_UNIPROT_ID'] = self.codes.get('NO_UNIPROT_ID', 0) + 1
+                self.results[gz_file] = CachedResult(*signature, 'NO_UNIPROT_ID', '-', '-', '-', '-')
                 return
 
         # print(f'{pdb_id} -> {uniprot_id}')
 
-        kmers = calculate_kmers(pdb_data)
-        # 4. write data to pdb & uniprot files
-        self._write_pdb_file(pdb_data.pdb_id, kmers)
-        if not self.handle_all_pdbs:
-            self._append_to_uniprot_file(uniprot_id, pdb_data.pdb_id, pdb_data)  # noqa
+        kmers = pdb_data.kmers if pdb_data.kmers is not None else calculate_kmers(pdb_data)
+        # 4. write data to k-mer corpus; the uniprot index is written from the results once all files are done
+        self.corpus.add(pdb_data.pdb_id, kmers)
+        self.results[gz_file] = CachedResult(*signature, 'SUCCESS', pdb_data.pdb_id, uniprot_id,
+                                             pdb_data.resolution, len(pdb_data.residue_sequence_parsed))
 
         # 5. pass kmers to natural set parser
         # TODO
 
-    @staticmethod
-    def extract_coordinates(gz_file):
-        proc = subprocess.Popen(['bin/extract_pdb_coordinates'],
-                                stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
-        with gzip.open(gz_file, 'r') as f_in:
-            pdb_str = f_in.read()
-
-        parsed_pdb, err = proc.communicate(input=pdb_str)
-
-        if proc.returncode != 0:
-            raise Exception(err.decode('utf-8').splitlines()[0])
-
-        return parsed_pdb
+    def cache_key(self):
+        """Identifies everything but the PDB files that the extraction results depend on"""
+        parts = [f'records{FORMAT_VERSION}', 'all' if self.handle_all_pdbs else 'uniprot']
+        for path in [EXTRACTOR] if self.handle_all_pdbs else [EXTRACTOR, self.db_path]:
+            mtime_ns, size = file_signature(path)
+            parts.append(f'{os.path.basename(path)}:{mtime_ns}:{size}')
+        return ','.join(parts)
 
     def process_files(self):
         """
-        Process all files in the process_dir
+        Process all files in the process_dir that are not in the extraction cache, or changed since.
+        A single extract_pdb_coordinates process decompresses and parses all of them, on all cores,
+        and computes the proximity k-mers. Its output is read as binary records.
+        The results of removed files are dropped, then the k-mer corpus index, the uniprot index and the
+        cache are rewritten to match the remaining files.
         :return:
         """
-        self.max_pdb_count = count_files(self.process_dir, '*.ent.gz')
-        print(f'Processing {self.max_pdb_count} PDB files files...')
-
         time_start = time.time()
 
-        for gz_file in Path(self.process_dir).rglob('*.ent.gz'):
-            self.process_gz_file(gz_file)
-            self.cur_pdb_count += 1
-
-            if self.cur_pdb_count % 100 == 0:
-                self.print_progress()
+        key = self.cache_key()
+        cached = load_cache(self.out_cache_path, key)
+        gz_files = [str(path) for path in sorted(Path(self.process_dir).rglob('*.ent.gz'))]
+        changed = []
+        for gz_file in gz_files:
+            self.signatures[gz_file] = file_signature(gz_file)
+            result = cached.get(gz_file)
+            if result is not None and (result.mtime_ns, result.size) == self.signatures[gz_file]:
+                self.results[gz_file] = result
+            else:
+                changed.append(gz_file)
+        removed = len(cached.keys() - set(gz_files))
+
+        self.max_pdb_count = max(1, len(changed))
+        print(f'Processing {len(changed)} of {len(gz_files)} PDB files ({len(self.results)} unchanged, '
+              f'{removed} removed)...')
+
+        store_args = ['--uniprot-store', str(self.db_path)] if self.uses_store else []
+        proc = subprocess.Popen([EXTRACTOR, '--kmers', '--format', 'binary', *store_args,
+                                 '--process-files', '-j', '0'],
+                                stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        # the extractor reads all paths before it writes any output
+        proc.stdin.write(''.join(f'{gz_file}\n' for gz_file in changed).encode())
+        proc.stdin.close()
+
+        with KmerCorpusWriter(self.out_corpus_path) as self.corpus:
+            for gz_file, code, pdb_data in read_records(proc.stdout):
+                self.process_parsed_pdb(gz_file, code, pdb_data)
+                self.cur_pdb_count += 1
+
+                if self.cur_pdb_count % 100 == 0:
+                    self.print_progress()
+
+        if proc.wait() != 0:
+            raise RuntimeError(f'extract_pdb_coordinates exited with code {proc.returncode}')
 
         self.print_progress()
+        self.write_outputs(key)
         time_end = time.time()
 
+        for result in self.results.values():
+            self.codes[result.code] = self.codes.get(result.code, 0) + 1
         self.print_codes()
         print(f'\nCompleted in {time_end - time_start:.2f} seconds')
 
+    def write_outputs(self, key):
+        """Rewrites the corpus index, the uniprot index and the cache from self.results"""
+        successful = [result for result in self.results.values() if result.code == 'SUCCESS']
+        retain_entries(self.out_corpus_path, {result.pdb_id for result in successful})
+
+        if not self.handle_all_pdbs:
+            index_path = f'{self.out_uniprot_index_path}.tmp'
+            if os.path.exists(index_path):
+                os.remove(index_path)
+            with UniprotIndexWriter(index_path) as uniprot_index:
+                for result in successful:
+                    uniprot_index.add(result.uniprot_id, result.pdb_id, result.resolution, result.sequence_length)
+            os.replace(index_path, self.out_uniprot_index_path)
+
+        save_cache(self.out_cache_path, key, self.results)
+
     def print_progress(self):
         print(f'\r{self.cur_pdb_count:<{len(str(self.max_pdb_count))}} / {self.max_pdb_count}, '
               f'{self.cur_pdb_count / self.max_pdb_count:.1%}', end='')
@@ -138,23 +201,3 @@ class GZProcessor:
         #     print(f'Found multiple matches for {sequence}: {all_matches}')
         return all_matches[0] if len(all_matches) > 0 else None
 
-    def _write_pdb_file(self, pdb_id: str, kmers: list[str]):
-        with open(f'{self.out_pdbs_dir}/{pdb_id}.kmers', 'w') as f_out:
-            for kmer in kmers:
-                f_out.write(f'{kmer}\n')
-
-    def _append_to_uniprot_file(self, uniprot_id: str, pdb_id: str, pdb_data: PDBData):
-        if not Path(f'{self.out_uniprot_dir}/{uniprot_id}.info').exists():
-            with open(f'{self.out_uniprot_dir}/{uniprot_id}.info', 'w') as f_out:
-                f_out.write(f'>{uniprot_id}\n')
-
-        with open(f'{self.out_uniprot_dir}/{uniprot_id}.info', 'a') as f_out:
-            f_out.write(f'{pdb_id} {pdb_data.resolution} {len(pdb_data.residue_sequence_parsed)} '
-                        f'{pdb_data.residue_sequence_parsed}\n')
-
-
-def count_files(directory='.', extension='*'):
-    count = 0
-    for _ in Path(directory).rglob(extension):
-        count += 1
-    return count
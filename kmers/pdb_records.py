@@ -0,0 +1,131 @@
+"""
+Reads the binary output of extract_pdb_coordinates (--format binary): a shard header, followed by one
+length-prefixed record per PDB file. The layout is documented in cpp_scripts/extract_pdb_coordinates/RecordFormat.h.
+
+read_records reads a shard from a stream (e.g. the stdout of extract_pdb_coordinates), read_shard memory-maps a
+shard file. Both yield (path, code, PDBData) for each record.
+"""
+import mmap
+import struct
+import sys
+from array import array
+
+from kmers.pdb_data import PDBData
+
+SHARD_MAGIC = b'PDBRECS\0'
+FORMAT_VERSION = 2
+
+RECORD_VALID = 1
+RECORD_HAS_KMERS = 2
+
+# PDB_PARSING_CODES in cpp_scripts/extract_pdb_coordinates/Constants.h, in order
+CODE_NAMES = [
+    'SUCCESS', 'RESOLUTION_TOO_LOW', 'RESOLUTION_NOT_SPECIFIED', 'MISSING_NON_TERMINAL_RESIDUES',
+    'NO_ALPHA_CARBON_ATOMS_FOUND', 'IS_NOT_PROTEIN', 'EXCLUDE_UNKNOWN_OR_RARE_AMINO_ACIDS', 'HAS_UNKNOWN_RESIDUE',
+    'INVALID_SEQUENCE', 'NO_UNIPROT_ID', 'FILE_NOT_READABLE', 'UNEXPECTED_ERROR',
+]
+
+_SHARD_HEADER = struct.Struct('<8sII')
+_RECORD_HEADER = struct.Struct('<IBBHfiII')  # length, then the fixed fields
+_LENGTH = struct.Struct('<I')
+
+
+def _align(offset):
+    return (offset + 3) & ~3
+
+
+def _floats(buffer, start, count):
+    values = array('f')
+    values.frombytes(buffer[start:start + 4 * count])
+    if sys.byteorder == 'big':
+        values.byteswap()
+    return values
+
+
+def _check_shard_header(header):
+    if len(header) < _SHARD_HEADER.size:
+        raise ValueError('not a record shard: too short')
+    magic, version, _ = _SHARD_HEADER.unpack_from(header)
+    if magic != SHARD_MAGIC:
+        raise ValueError('not a record shard')
+    if version != FORMAT_VERSION:
+        raise ValueError(f'record format version {version}, expected {FORMAT_VERSION}')
+
+
+def parse_record(buffer, offset=0):
+    """
+    Parses the record starting at offset (a multiple of 4) of buffer.
+    :return: (path, code, PDBData, offset of the next record)
+    """
+    length, code, flags, other_count, resolution, first_residue, residue_count, kmer_bytes = \
+        _RECORD_HEADER.unpack_from(buffer, offset)
+    end = offset + _LENGTH.size + length
+    position = offset + _RECORD_HEADER.size
+
+    strings = []
+    for _ in range(6 + other_count):
+        (size,) = _LENGTH.unpack_from(buffer, position)
+        position += _LENGTH.size
+        strings.append(bytes(buffer[position:position + size]).decode('utf-8'))
+        position += size
+    path, pdb_id, uniprot_ids, matched_uniprot_id, matched, parsed = strings[:6]
+    position = _align(position)
+
+    residues = bytes(buffer[position:position + residue_count]).decode('ascii')
+    position = _align(position + residue_count)
+    x = _floats(buffer, position, residue_count)
+    y = _floats(buffer, position + 4 * residue_count, residue_count)
+    z = _floats(buffer, position + 8 * residue_count, residue_count)
+    position += 12 * residue_count
+
+    kmers = None
+    if flags & RECORD_HAS_KMERS:
+        offsets = array('I')
+        offsets.frombytes(buffer[position:position + 4 * (residue_count + 1)])
+        if sys.byteorder == 'big':
+            offsets.byteswap()
+        start = position + 4 * (residue_count + 1)
+        data = bytes(buffer[start:start + kmer_bytes]).decode('ascii')
+        kmers = [data[offsets[i]:offsets[i + 1]] for i in range(residue_count)]
+
+    pdb_data = PDBData.from_record(
+        success=bool(flags & RECORD_VALID), pdb_id=pdb_id, resolution=resolution,
+        uniprot_ids=uniprot_ids.split(','), matched_uniprot_id=matched_uniprot_id or None,
+        matched_sequence=matched, parsed_sequence=parsed, other_sequences=strings[6:], first_residue_number=first_residue,
+        residues=residues, coordinates=(x, y, z), kmers=kmers)
+    return path, CODE_NAMES[code], pdb_data, end
+
+
+def read_records(stream):
+    """
+    Reads a shard from a binary stream, record by record.
+    Yields (path, code, PDBData) for each record.
+    """
+    _check_shard_header(stream.read(_SHARD_HEADER.size))
+    while True:
+        prefix = stream.read(_LENGTH.size)
+        if len(prefix) < _LENGTH.size:
+            return
+        (length,) = _LENGTH.unpack(prefix)
+        path, code, pdb_data, _ = parse_record(prefix + stream.read(length))
+        yield path, code, pdb_data
+
+
+def read_shard(path):
+    """
+    Memory-maps the shard file at path and reads it front to back.
+    Yields (path, code, PDBData) for each record.
+    """
+    with open(path, 'rb') as f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as mapped:
+        if hasattr(mapped, 'madvise') and hasattr(mmap, 'MADV_SEQUENTIAL'):
+            mapped.madvise(mmap.MADV_SEQUENTIAL)
+        _check_shard_header(mapped)
+
+        view = memoryview(mapped)
+        try:
+            offset = _SHARD_HEADER.size
+            while offset + _LENGTH.size <= len(mapped):
+                record_path, code, pdb_data, offset = parse_record(view, offset)
+                yield record_path, code, pdb_data
+        finally:
+            view.release()
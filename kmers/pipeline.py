@@ -5,13 +5,13 @@ from pathlib import Path
 from kmers.pdb_gz_processor import GZProcessor
 
 """
-- 1. OS walk through all PDB gz files 
+- 1. OS walk through all PDB gz files; with --incremental, skip those unchanged since the last run
 - 2. Extract the gz files
 - 3. extract the PDB coordinates annotated with CA (with C++ script) (PDB_ID.coor)
 -     3.1. If unsuccessful (return 1), delete extracted file & created file, next file
 -     3.2 If successful, delete extracted file & continue to 4.
 - 4. Calculate the Kmers
-5. Write them to file (PDB_ID.kmers)
+5. Append them to the k-mer corpus (pdb_output/kmers.corpus)
 6. Repeat for all files
 
 After batch processing all files:
@@ -78,12 +78,17 @@ if __name__ == '__main__':
     parser = argparse.ArgumentParser(description='Process PDB files.')
     parser.add_argument('--handle_all_pdbs', required=True, type=bool,
                         help='Set to True to handle all PDBs without checking for uniprot IDs')
+    parser.add_argument('--incremental', action='store_true',
+                        help='Update the output of an earlier run, extracting only PDB files added or changed since')
     args = parser.parse_args()
 
     if args.handle_all_pdbs not in [True, False]:
         raise ValueError("The --handle_all_pdbs argument must be set to either True or False.")
 
-    db_path = os.path.expanduser('uniprotkb/uniprot_sequences.db')
+    # the sequence store (fasta_to_sqlite --store) is preferred over the SQLite database
+    db_path = os.path.expanduser('uniprotkb/uniprot_sequences.store')
+    if not os.path.exists(db_path):
+        db_path = os.path.expanduser('uniprotkb/uniprot_sequences.db')
 
     if not args.handle_all_pdbs:  # Only check for database if we need it
         try:
@@ -107,20 +112,22 @@ if __name__ == '__main__':
         exit(1)
 
     output_dir = 'pdb_output'
+    out_cache = os.path.join(output_dir, 'extraction.cache')
     try:
-        check_empty_directory(output_dir)
+        # an incremental run continues from the extraction cache of an earlier run
+        if not (args.incremental and os.path.exists(out_cache)):
+            check_empty_directory(output_dir)
     except RuntimeError:
         print("Error: Output directory 'pdb_output' is not empty. Aborting."
-              "If you want to re-run the script, delete the directory first.")
+              "If you want to re-run the script, delete the directory first, or pass --incremental "
+              "if it was written by a run with an extraction cache.")
         exit(1)
 
     if not os.path.exists(output_dir):
         os.makedirs(output_dir)
-        os.makedirs(os.path.join(output_dir, 'uniprot'))
-        os.makedirs(os.path.join(output_dir, 'pdbs'))
 
-    out_uniprot = os.path.join(output_dir, 'uniprot')
-    out_pdbs = os.path.join(output_dir, 'pdbs')
+    out_uniprot_index = os.path.join(output_dir, 'uniprot.index')
+    out_corpus = os.path.join(output_dir, 'kmers.corpus')
 
-    processor = GZProcessor(db_path, process_dir, out_uniprot, out_pdbs, args.handle_all_pdbs)
+    processor = GZProcessor(db_path, process_dir, out_uniprot_index, out_corpus, out_cache, args.handle_all_pdbs)
     processor.process_files()
\ No newline at end of file
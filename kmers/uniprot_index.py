@@ -0,0 +1,32 @@
+"""
+Index of the PDBs matched to each UniProt entry, replacing one pdb_output/uniprot/<id>.info file per entry.
+post_process_kmers groups it by UniProt id and selects one representative PDB per entry; the reader is
+cpp_scripts/post_process_kmers/UniprotIndex.h:
+
+    'UNIPROTIDX <version>', then one line '<uniprot id> <pdb id> <resolution> <sequence length>' per PDB
+"""
+import os
+
+MAGIC = 'UNIPROTIDX'
+VERSION = 1
+
+
+class UniprotIndexWriter:
+    def __init__(self, path):
+        self.path = path
+        new_index = not os.path.exists(path) or os.path.getsize(path) == 0
+        self._index = open(path, 'a')
+        if new_index:
+            self._index.write(f'{MAGIC} {VERSION}\n')
+
+    def add(self, uniprot_id, pdb_id, resolution, sequence_length):
+        self._index.write(f'{uniprot_id} {pdb_id} {resolution} {sequence_length}\n')
+
+    def close(self):
+        self._index.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
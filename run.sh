@@ -3,7 +3,13 @@
 mdir=$(dirname $(realpath "$0"))
 cd "$mdir"
 
-for file in "bin/fasta_to_sqlite" "bin/post_process_kmers" "bin/extract_pdb_coordinates"; do
+# ./run.sh --incremental keeps intermediate output in pdb_output, so that later runs only process what changed
+incremental=false
+if [[ "$1" == "--incremental" || -f pdb_output/extraction.cache ]]; then
+    incremental=true
+fi
+
+for file in "bin/fasta_to_sqlite" "bin/post_process_kmers" "bin/extract_pdb_coordinates" "bin/kmer_pipeline"; do
     if ! [ -e "$file" ]; then
         echo "Could not locate binaries. Starting compilation."
         scripts/buildcpp.sh
@@ -31,10 +37,12 @@ select process_option in "${options[@]}"; do [[ "$process_option" ]] && break; d
 
 uniprot_files=("uniprotkb/uniprot_sprot.fasta.gz" "uniprotkb/uniprot_trembl.fasta.gz")
 dbfile="$mdir/uniprotkb/uniprot_sequences.db"
+storefile="$mdir/uniprotkb/uniprot_sequences.store"
 
 if [[ "$process_option" == "Process PDBs matching UniProt" ]]; then
-    if [[ ! -f "$dbfile" ]]; then
-        echo "Database file not found."
+    # an existing SQLite database is still used if there is no sequence store
+    if [[ ! -f "$storefile" && ! -f "$dbfile" ]]; then
+        echo "Sequence store not found."
         # checking for uniprot files
         found_files=0
         for filepath in "${uniprot_files[@]}"; do
@@ -46,34 +54,34 @@ if [[ "$process_option" == "Process PDBs matching UniProt" ]]; then
             echo "No Uniprot files found. Download from https://www.uniprot.org/downloads and place in 'uniprotkb' directory. Required: uniprot_sprot.fasta.gz (350MB uncompressed); Optional: uniprot_sprot.fasta.gz + uniprot_trembl.fasta.gz (250GB uncompressed)."
             exit 1
         else
-            echo "Creating database."
-            # Check if gzip is installed
-            command -v gzip >/dev/null 2>&1 || { echo >&2 "gzip required but it's not installed. Aborting."; exit 1; }
-            # Only process the files found
+            echo "Creating sequence store."
+            # Only process the files found; fasta_to_sqlite decompresses them itself
+            found_paths=()
             for filepath in "${uniprot_files[@]}"; do
                 if [[ -f "$mdir/$filepath" ]]; then
                     echo "Processing $filepath..."
-                    gunzip -c "$mdir/$filepath" | ./bin/fasta_to_sqlite
+                    found_paths+=("$mdir/$filepath")
                 fi
             done
-
-            echo "Creating index."
-            sqlite3 "$dbfile" "CREATE INDEX IF NOT EXISTS idx_id ON sequences (id);"
-            echo "Done creating database."
+            ./bin/fasta_to_sqlite --store "$storefile" "${found_paths[@]}" || { rm -f "$storefile.tmp"; exit 1; }
+            echo "Done creating sequence store."
         fi
     fi
 fi
 
 k=12
 while true; do
-    read -p "Enter k-mer length (default is 12): " input_k
+    read -p "Enter k-mer length, or a range like 6-20 (default is 12): " input_k
     if [[ -z "$input_k" ]]; then
         break
-    elif [[ "$input_k" =~ ^[0-9]+$ ]] && [[ "$input_k" -ge 1 ]] && [[ "$input_k" -le 100 ]]; then
+    elif [[ "$input_k" =~ ^([0-9]+)(-([0-9]+))?$ ]] && [[ "${BASH_REMATCH[1]}" -ge 1 ]] \
+            && [[ "${BASH_REMATCH[3]:-${BASH_REMATCH[1]}}" -ge "${BASH_REMATCH[1]}" ]] \
+            && [[ "${BASH_REMATCH[3]:-${BASH_REMATCH[1]}}" -le 100 ]]; then
         k="$input_k"
+        [[ "${k%-*}" == "${k#*-}" ]] && k="${k%-*}" # a range of one size is a single size
         break
     else
-        echo "Invalid input. Please enter a valid integer <= 100."
+        echo "Invalid input. Please enter a valid integer <= 100, or a range of them."
     fi
 done
 
@@ -82,17 +90,31 @@ echo $k
 
 echo "Generating k-mers from PDBs."
 
-# run python pipeline
-if [[ "$process_option" == "Process all PDBs" ]]; then
-    PYTHONPATH="${PYTHONPATH}:$mdir" python3 kmers/pipeline.py --handle_all_pdbs true
-    echo "Extracting most frequent k-mers of length k=$k"
-    ./bin/post_process_kmers -a -k "$k" > kmers.txt
+# with --incremental, or once pdb_output holds the output of such a run, the python pipeline keeps its output, and a
+# re-run only extracts the PDB files added or changed since, and updates the counts; otherwise kmer_pipeline extracts
+# and counts in one pass, without intermediate files. Matching an SQLite database also needs the python pipeline.
+if [[ "$incremental" == true || ( "$process_option" != "Process all PDBs" && ! -f "$storefile" ) ]]; then
+    if [[ "$process_option" == "Process all PDBs" ]]; then
+        PYTHONPATH="${PYTHONPATH}:$mdir" python3 kmers/pipeline.py --handle_all_pdbs true --incremental || exit 1
+        echo "Extracting most frequent k-mers of length k=$k"
+        ./bin/post_process_kmers -a -k "$k" -j 0 --state pdb_output/kmer_counts.state > kmers.txt
+    else
+        PYTHONPATH="${PYTHONPATH}:$mdir" python3 kmers/pipeline.py --handle_all_pdbs false --incremental || exit 1
+        echo "Extracting most frequent k-mers of length k=$k"
+        ./bin/post_process_kmers -k "$k" -j 0 --state pdb_output/kmer_counts.state > kmers.txt
+    fi
+elif [[ "$process_option" == "Process all PDBs" ]]; then
+    ./bin/kmer_pipeline -a -k "$k" -j 0 pdb > kmers.txt || exit 1
 else
-    PYTHONPATH="${PYTHONPATH}:$mdir" python3 kmers/pipeline.py --handle_all_pdbs false
-    echo "Extracting most frequent k-mers of length k=$k"
-    ./bin/post_process_kmers -k "$k" > kmers.txt
+    ./bin/kmer_pipeline --uniprot-store "$storefile" -k "$k" -j 0 pdb > kmers.txt || exit 1
 fi
 echo "Done generating k-mers."
-echo "Finished. Results in \`kmers.txt\`"
-echo "Top k-mers"
-cat kmers.txt | head
+if [[ "$k" == *-* ]]; then
+    # a range of sizes is written to kmers_k<size>.txt, one file per size
+    rm -f kmers.txt
+    echo "Finished. Results in \`kmers_k${k%-*}.txt\` to \`kmers_k${k#*-}.txt\`"
+else
+    echo "Finished. Results in \`kmers.txt\`"
+    echo "Top k-mers"
+    cat kmers.txt | head
+fi
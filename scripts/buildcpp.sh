@@ -13,19 +13,35 @@ echo "Compiling C++ binaries."
 
 mkdir -p bin
 
-arch -x86_64 g++ -std=c++17 -o "bin/fasta_to_sqlite" cpp_scripts/fasta_to_sqlite/*.cpp -lsqlite3
+arch -x86_64 g++ -std=c++17 -O2 -o "bin/fasta_to_sqlite" cpp_scripts/fasta_to_sqlite/*.cpp -lsqlite3 -lz -pthread
 if [ $? -ne 0 ]; then
     echo "Compilation failed."
     exit 1
 fi
 
-g++ -std=c++17 -o "bin/post_process_kmers" cpp_scripts/post_process_kmers/*.cpp
+g++ -std=c++17 -O2 -o "bin/post_process_kmers" cpp_scripts/post_process_kmers/*.cpp -pthread
 if [ $? -ne 0 ]; then
     echo "Compilation failed."
     exit 1
 fi
 
-g++ -std=c++17 -o "bin/extract_pdb_coordinates" cpp_scripts/extract_pdb_coordinates/*.cpp
+g++ -std=c++17 -O2 -o "bin/extract_pdb_coordinates" cpp_scripts/extract_pdb_coordinates/*.cpp -lz -pthread
+if [ $? -ne 0 ]; then
+    echo "Compilation failed."
+    exit 1
+fi
+
+# benchmarks link against the extractor and fasta_to_sqlite, without their main()
+extract_sources=$(ls cpp_scripts/extract_pdb_coordinates/*.cpp | grep -v '/extract_pdb_coordinates.cpp$')
+fasta_sources=$(ls cpp_scripts/fasta_to_sqlite/*.cpp | grep -v '/uniprot_to_sqlite.cpp$')
+g++ -std=c++17 -O2 -o "bin/benchmark" cpp_scripts/benchmark/*.cpp $extract_sources $fasta_sources -lsqlite3 -lz -pthread
+if [ $? -ne 0 ]; then
+    echo "Compilation failed."
+    exit 1
+fi
+
+# the fused pipeline links against the extractor too
+g++ -std=c++17 -O2 -o "bin/kmer_pipeline" cpp_scripts/kmer_pipeline/*.cpp $extract_sources -lz -pthread
 if [ $? -ne 0 ]; then
     echo "Compilation failed."
     exit 1